@@ -0,0 +1,595 @@
+/*
+* Copyright (c) 2006-2011 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "Testbed/Framework/Test.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// Runs the Testbed scenes without graphics and writes per-stage timings as
+// JSON, so changes can be compared against a saved baseline. With
+// --check-threads it instead checks that every scene steps the same on N
+// threads as on one.
+//
+// Usage: Benchmark [--steps N] [--threads N] [--wide] [--scene NAME]...
+//                  [--out FILE] [--baseline FILE] [--check-threads]
+
+// The tests draw through these. Nothing is drawn here.
+DebugDraw g_debugDraw;
+Camera g_camera;
+
+DebugDraw::DebugDraw() : m_points(NULL), m_lines(NULL), m_triangles(NULL) {}
+DebugDraw::~DebugDraw() {}
+void DebugDraw::Create() {}
+void DebugDraw::Destroy() {}
+void DebugDraw::DrawPolygon(const b2Vec2*, int32, const b2Color&) {}
+void DebugDraw::DrawSolidPolygon(const b2Vec2*, int32, const b2Color&) {}
+void DebugDraw::DrawCircle(const b2Vec2&, float32, const b2Color&) {}
+void DebugDraw::DrawSolidCircle(const b2Vec2&, float32, const b2Vec2&, const b2Color&) {}
+void DebugDraw::DrawSegment(const b2Vec2&, const b2Vec2&, const b2Color&) {}
+void DebugDraw::DrawTransform(const b2Transform&) {}
+void DebugDraw::DrawPoint(const b2Vec2&, float32, const b2Color&) {}
+void DebugDraw::DrawString(int, int, const char*, ...) {}
+void DebugDraw::DrawString(const b2Vec2&, const char*, ...) {}
+void DebugDraw::DrawAABB(b2AABB*, const b2Color&) {}
+void DebugDraw::Flush() {}
+b2Vec2 Camera::ConvertScreenToWorld(const b2Vec2& screenPoint) { return screenPoint; }
+b2Vec2 Camera::ConvertWorldToScreen(const b2Vec2& worldPoint) { return worldPoint; }
+void Camera::BuildProjectionMatrix(float32*, float32) {}
+
+enum Stage
+{
+	e_stepStage,
+	e_collideStage,
+	e_solveStage,
+	e_solveInitStage,
+	e_solveVelocityStage,
+	e_solvePositionStage,
+	e_broadphaseStage,
+	e_solveTOIStage,
+	e_stageCount
+};
+
+static const char* s_stageNames[e_stageCount] =
+{
+	"step", "collide", "solve", "solveInit", "solveVelocity", "solvePosition", "broadphase", "solveTOI"
+};
+
+struct Options
+{
+	int32 steps;
+	int32 threads;
+	bool wide;
+	bool checkThreads;
+	std::vector<const char*> scenes;
+	const char* out;
+	const char* baseline;
+};
+
+struct StageStats
+{
+	float64 mean;
+	float64 p50;
+	float64 p95;
+	float64 p99;
+	float64 max;
+};
+
+struct SceneResult
+{
+	const char* name;
+	int32 bodyCount;
+	int32 contactCount;
+	int32 jointCount;
+	float64 seconds;
+	float64 stepsPerSecond;
+	StageStats stages[e_stageCount];
+};
+
+static void PrintUsage()
+{
+	printf("Usage: Benchmark [--steps N] [--threads N] [--wide] [--scene NAME]... [--out FILE] [--baseline FILE] [--check-threads]\n");
+	printf("  --steps N        steps to run per scene (default 1000)\n");
+	printf("  --threads N      solver threads, 1 runs everything on the calling thread\n");
+	printf("  --wide           use the wide contact solver\n");
+	printf("  --scene NAME     run only the named scene, may be repeated\n");
+	printf("  --out FILE       write the JSON to FILE instead of stdout\n");
+	printf("  --baseline FILE  compare with JSON written by an earlier run\n");
+	printf("  --check-threads  check that each step on --threads threads (default 4) gives\n");
+	printf("                   the same bodies and contact callbacks as on one thread\n");
+	printf("Scenes:\n");
+	for (TestEntry* entry = g_testEntries; entry->createFcn; ++entry)
+	{
+		printf("  %s\n", entry->name);
+	}
+}
+
+static bool ParseOptions(int argc, char** argv, Options* options)
+{
+	options->steps = 1000;
+	options->threads = 1;
+	options->wide = false;
+	options->checkThreads = false;
+	options->out = NULL;
+	options->baseline = NULL;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (strcmp(arg, "--steps") == 0 && hasValue)
+		{
+			options->steps = b2Max(atoi(argv[++i]), 1);
+		}
+		else if (strcmp(arg, "--threads") == 0 && hasValue)
+		{
+			options->threads = b2Max(atoi(argv[++i]), 1);
+		}
+		else if (strcmp(arg, "--wide") == 0)
+		{
+			options->wide = true;
+		}
+		else if (strcmp(arg, "--scene") == 0 && hasValue)
+		{
+			options->scenes.push_back(argv[++i]);
+		}
+		else if (strcmp(arg, "--out") == 0 && hasValue)
+		{
+			options->out = argv[++i];
+		}
+		else if (strcmp(arg, "--baseline") == 0 && hasValue)
+		{
+			options->baseline = argv[++i];
+		}
+		else if (strcmp(arg, "--check-threads") == 0)
+		{
+			options->checkThreads = true;
+		}
+		else
+		{
+			PrintUsage();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool IsSelected(const Options& options, const char* name)
+{
+	if (options.scenes.empty())
+	{
+		return true;
+	}
+
+	for (size_t i = 0; i < options.scenes.size(); ++i)
+	{
+		if (strcmp(options.scenes[i], name) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Nearest rank percentile of sorted samples.
+static float64 Percentile(const std::vector<float32>& sorted, float64 p)
+{
+	int32 count = int32(sorted.size());
+	int32 rank = int32(ceil(p * count));
+	return sorted[b2Clamp(rank - 1, 0, count - 1)];
+}
+
+static StageStats ComputeStats(std::vector<float32>& samples)
+{
+	StageStats stats;
+	float64 sum = 0.0;
+	for (size_t i = 0; i < samples.size(); ++i)
+	{
+		sum += samples[i];
+	}
+
+	std::sort(samples.begin(), samples.end());
+	stats.mean = sum / samples.size();
+	stats.p50 = Percentile(samples, 0.50);
+	stats.p95 = Percentile(samples, 0.95);
+	stats.p99 = Percentile(samples, 0.99);
+	stats.max = samples.back();
+	return stats;
+}
+
+static SceneResult RunScene(const TestEntry* entry, const Options& options)
+{
+	Settings settings;
+	settings.drawShapes = false;
+	settings.drawJoints = false;
+	settings.threadCount = options.threads;
+	settings.enableWideSolving = options.wide;
+
+	// Some scenes are randomized. Give every run the same sequence.
+	srand(0);
+
+	Test* test = entry->createFcn();
+
+	std::vector<float32> samples[e_stageCount];
+	for (int32 i = 0; i < e_stageCount; ++i)
+	{
+		samples[i].reserve(options.steps);
+	}
+
+	b2Timer timer;
+	for (int32 i = 0; i < options.steps; ++i)
+	{
+		test->Step(&settings);
+
+		const b2Profile& p = test->GetWorld()->GetProfile();
+		samples[e_stepStage].push_back(p.step);
+		samples[e_collideStage].push_back(p.collide);
+		samples[e_solveStage].push_back(p.solve);
+		samples[e_solveInitStage].push_back(p.solveInit);
+		samples[e_solveVelocityStage].push_back(p.solveVelocity);
+		samples[e_solvePositionStage].push_back(p.solvePosition);
+		samples[e_broadphaseStage].push_back(p.broadphase);
+		samples[e_solveTOIStage].push_back(p.solveTOI);
+	}
+
+	SceneResult result;
+	result.seconds = 0.001 * timer.GetMilliseconds();
+	result.stepsPerSecond = result.seconds > 0.0 ? options.steps / result.seconds : 0.0;
+	result.name = entry->name;
+	result.bodyCount = test->GetWorld()->GetBodyCount();
+	result.contactCount = test->GetWorld()->GetContactCount();
+	result.jointCount = test->GetWorld()->GetJointCount();
+
+	for (int32 i = 0; i < e_stageCount; ++i)
+	{
+		result.stages[i] = ComputeStats(samples[i]);
+	}
+
+	delete test;
+	return result;
+}
+
+// FNV-1a hash of the body states after each step and of every contact callback
+// made during it, in order. Callbacks are passed on to the test.
+class StepHash : public b2ContactListener
+{
+public:
+	StepHash(b2ContactListener* test) : m_test(test), m_hash(14695981039346656037ull) {}
+
+	void BeginContact(b2Contact* contact) override
+	{
+		AddContact('B', contact);
+		m_test->BeginContact(contact);
+	}
+
+	void EndContact(b2Contact* contact) override
+	{
+		AddContact('E', contact);
+		m_test->EndContact(contact);
+	}
+
+	void PreSolve(b2Contact* contact, const b2Manifold* oldManifold) override
+	{
+		AddContact('P', contact);
+		m_test->PreSolve(contact, oldManifold);
+	}
+
+	void PostSolve(b2Contact* contact, const b2ContactImpulse* impulse) override
+	{
+		AddContact('S', contact);
+		Add(impulse->normalImpulses, impulse->count * sizeof(float32));
+		Add(impulse->tangentImpulses, impulse->count * sizeof(float32));
+		m_test->PostSolve(contact, impulse);
+	}
+
+	// Finish the hash of a step with the state of every body.
+	unsigned long long EndStep(b2World* world)
+	{
+		for (b2Body* b = world->GetBodyList(); b; b = b->GetNext())
+		{
+			b2Transform xf = b->GetTransform();
+			b2Vec2 v = b->GetLinearVelocity();
+			float32 w = b->GetAngularVelocity();
+			bool awake = b->IsAwake();
+			Add(&xf, sizeof(xf));
+			Add(&v, sizeof(v));
+			Add(&w, sizeof(w));
+			Add(&awake, sizeof(awake));
+		}
+
+		unsigned long long hash = m_hash;
+		m_hash = 14695981039346656037ull;
+		return hash;
+	}
+
+private:
+	void Add(const void* data, size_t size)
+	{
+		const uint8* bytes = (const uint8*)data;
+		for (size_t i = 0; i < size; ++i)
+		{
+			m_hash = (m_hash ^ bytes[i]) * 1099511628211ull;
+		}
+	}
+
+	// Contacts are identified by their bodies' positions and their manifold.
+	// An empty manifold, like a sensor's, leaves its normal and point unset.
+	void AddContact(char event, b2Contact* contact)
+	{
+		const b2Manifold* manifold = contact->GetManifold();
+		Add(&event, 1);
+		Add(&contact->GetFixtureA()->GetBody()->GetPosition(), sizeof(b2Vec2));
+		Add(&contact->GetFixtureB()->GetBody()->GetPosition(), sizeof(b2Vec2));
+		Add(&manifold->pointCount, sizeof(manifold->pointCount));
+		if (manifold->pointCount > 0)
+		{
+			Add(&manifold->localNormal, sizeof(b2Vec2));
+			Add(&manifold->localPoint, sizeof(b2Vec2));
+		}
+		for (int32 i = 0; i < manifold->pointCount; ++i)
+		{
+			Add(&manifold->points[i].localPoint, sizeof(b2Vec2));
+		}
+	}
+
+	b2ContactListener* m_test;
+	unsigned long long m_hash;
+};
+
+// Step hashes of a scene run on the given number of threads.
+static std::vector<unsigned long long> HashScene(const TestEntry* entry, const Options& options, int32 threads)
+{
+	Settings settings;
+	settings.drawShapes = false;
+	settings.drawJoints = false;
+	settings.threadCount = threads;
+	settings.enableWideSolving = options.wide;
+
+	srand(0);
+
+	Test* test = entry->createFcn();
+	StepHash hash(test);
+	test->GetWorld()->SetContactListener(&hash);
+
+	std::vector<unsigned long long> hashes;
+	hashes.reserve(options.steps);
+	for (int32 i = 0; i < options.steps; ++i)
+	{
+		test->Step(&settings);
+		hashes.push_back(hash.EndStep(test->GetWorld()));
+	}
+
+	delete test;
+	return hashes;
+}
+
+// Returns false if the threaded run differs from the single threaded one.
+static bool CheckThreads(const TestEntry* entry, const Options& options)
+{
+	int32 threads = options.threads > 1 ? options.threads : 4;
+	std::vector<unsigned long long> serial = HashScene(entry, options, 1);
+	std::vector<unsigned long long> threaded = HashScene(entry, options, threads);
+	for (int32 i = 0; i < options.steps; ++i)
+	{
+		if (serial[i] != threaded[i])
+		{
+			printf("%-24s differs from step %d on %d threads\n", entry->name, i + 1, threads);
+			return false;
+		}
+	}
+
+	printf("%-24s same on 1 and %d threads\n", entry->name, threads);
+	return true;
+}
+
+static void WriteJson(FILE* file, const Options& options, const std::vector<SceneResult>& results)
+{
+	fprintf(file, "{\n");
+	fprintf(file, "  \"steps\": %d,\n", options.steps);
+	fprintf(file, "  \"threads\": %d,\n", options.threads);
+	fprintf(file, "  \"wide\": %s,\n", options.wide ? "true" : "false");
+	fprintf(file, "  \"units\": \"ms\",\n");
+	fprintf(file, "  \"scenes\": [\n");
+
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const SceneResult& r = results[i];
+		fprintf(file, "    {\n");
+		fprintf(file, "      \"name\": \"%s\",\n", r.name);
+		fprintf(file, "      \"bodies\": %d,\n", r.bodyCount);
+		fprintf(file, "      \"contacts\": %d,\n", r.contactCount);
+		fprintf(file, "      \"joints\": %d,\n", r.jointCount);
+		fprintf(file, "      \"seconds\": %.6f,\n", r.seconds);
+		fprintf(file, "      \"stepsPerSecond\": %.2f,\n", r.stepsPerSecond);
+
+		for (int32 j = 0; j < e_stageCount; ++j)
+		{
+			const StageStats& s = r.stages[j];
+			fprintf(file, "      \"%s\": { \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+				s_stageNames[j], s.mean, s.p50, s.p95, s.p99, s.max, j + 1 < e_stageCount ? "," : "");
+		}
+
+		fprintf(file, "    }%s\n", i + 1 < results.size() ? "," : "");
+	}
+
+	fprintf(file, "  ]\n");
+	fprintf(file, "}\n");
+}
+
+// Find a number field of a scene in JSON written by WriteJson.
+static bool FindBaselineValue(const char* json, const char* name, const char* field, float64* value)
+{
+	char key[256];
+	sprintf(key, "\"name\": \"%.200s\"", name);
+	const char* scene = strstr(json, key);
+	if (scene == NULL)
+	{
+		return false;
+	}
+
+	const char* end = strstr(scene, "\n    }");
+	sprintf(key, "\"%.200s\"", field);
+	const char* p = strstr(scene, key);
+	if (p == NULL || (end && p > end))
+	{
+		return false;
+	}
+
+	p = strchr(p + strlen(key), ':');
+	if (p == NULL)
+	{
+		return false;
+	}
+
+	// Stage fields are objects, compare their median.
+	const char* brace = strchr(p, '{');
+	const char* comma = strchr(p, ',');
+	if (brace && comma && brace < comma)
+	{
+		p = strstr(brace, "\"p50\":");
+		if (p == NULL)
+		{
+			return false;
+		}
+		p += 6;
+	}
+	else
+	{
+		p += 1;
+	}
+
+	*value = strtod(p, NULL);
+	return true;
+}
+
+static void CompareBaseline(const char* path, const std::vector<SceneResult>& results)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == NULL)
+	{
+		fprintf(stderr, "Cannot open baseline %s\n", path);
+		return;
+	}
+
+	std::vector<char> json;
+	char buffer[4096];
+	size_t count;
+	while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		json.insert(json.end(), buffer, buffer + count);
+	}
+	json.push_back(0);
+	fclose(file);
+
+	fprintf(stderr, "%-24s %12s %12s %8s %10s %10s %8s\n", "scene", "steps/s", "baseline", "speedup", "p50 ms", "baseline", "ratio");
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const SceneResult& r = results[i];
+		float64 baseRate, baseStep;
+		if (FindBaselineValue(json.data(), r.name, "stepsPerSecond", &baseRate) == false ||
+			FindBaselineValue(json.data(), r.name, "step", &baseStep) == false)
+		{
+			fprintf(stderr, "%-24s %12.1f %12s\n", r.name, r.stepsPerSecond, "-");
+			continue;
+		}
+
+		float64 p50 = r.stages[e_stepStage].p50;
+		fprintf(stderr, "%-24s %12.1f %12.1f %7.2fx %10.4f %10.4f %8.2f\n", r.name, r.stepsPerSecond, baseRate,
+			baseRate > 0.0 ? r.stepsPerSecond / baseRate : 0.0, p50, baseStep, baseStep > 0.0 ? p50 / baseStep : 0.0);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (ParseOptions(argc, argv, &options) == false)
+	{
+		return 1;
+	}
+
+	if (options.checkThreads)
+	{
+		bool same = true;
+		bool matched = false;
+		for (TestEntry* entry = g_testEntries; entry->createFcn; ++entry)
+		{
+			if (IsSelected(options, entry->name))
+			{
+				same = CheckThreads(entry, options) && same;
+				matched = true;
+			}
+		}
+
+		if (matched == false)
+		{
+			fprintf(stderr, "No scene matched\n");
+			return 1;
+		}
+
+		return same ? 0 : 1;
+	}
+
+	std::vector<SceneResult> results;
+	for (TestEntry* entry = g_testEntries; entry->createFcn; ++entry)
+	{
+		if (IsSelected(options, entry->name) == false)
+		{
+			continue;
+		}
+
+		fprintf(stderr, "%s...\n", entry->name);
+		results.push_back(RunScene(entry, options));
+	}
+
+	if (results.empty())
+	{
+		fprintf(stderr, "No scene matched\n");
+		return 1;
+	}
+
+	FILE* file = stdout;
+	if (options.out)
+	{
+		file = fopen(options.out, "w");
+		if (file == NULL)
+		{
+			fprintf(stderr, "Cannot write %s\n", options.out);
+			return 1;
+		}
+	}
+
+	WriteJson(file, options, results);
+
+	if (file != stdout)
+	{
+		fclose(file);
+	}
+
+	if (options.baseline)
+	{
+		CompareBaseline(options.baseline, results);
+	}
+
+	return 0;
+}
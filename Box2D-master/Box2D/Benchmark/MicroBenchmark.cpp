@@ -0,0 +1,714 @@
+/*
+* Copyright (c) 2006-2011 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "Box2D/Box2D.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// Times the collision and tree query kernels in isolation on seeded random
+// inputs and reports nanoseconds and b2Alloc calls per operation.
+//
+// Usage: MicroBenchmark [--filter TEXT] [--seed N] [--samples N] [--time MS] [--json FILE]
+
+// Every kernel cycles through this many random cases.
+#define b2_caseCount 256
+
+static int32 s_allocCount = 0;
+
+static void* CountingAlloc(int32 size)
+{
+	++s_allocCount;
+	return malloc(size);
+}
+
+static void CountingFree(void* mem)
+{
+	free(mem);
+}
+
+// Keeps the compiler from discarding the kernel results.
+static volatile float64 s_sink = 0.0;
+
+// xorshift32, so the inputs are the same on every platform.
+class Random
+{
+public:
+	Random(uint32 seed)
+	{
+		m_state = seed ? seed : 0x9e3779b9;
+	}
+
+	uint32 NextUInt()
+	{
+		m_state ^= m_state << 13;
+		m_state ^= m_state >> 17;
+		m_state ^= m_state << 5;
+		return m_state;
+	}
+
+	float32 Next(float32 lo, float32 hi)
+	{
+		float32 r = float32(NextUInt() >> 8) / float32(1 << 24);
+		return lo + r * (hi - lo);
+	}
+
+	b2Vec2 NextVec(float32 lo, float32 hi)
+	{
+		float32 x = Next(lo, hi);
+		float32 y = Next(lo, hi);
+		return b2Vec2(x, y);
+	}
+
+private:
+	uint32 m_state;
+};
+
+// A convex polygon with exactly count vertices on a circle of the given radius.
+static b2PolygonShape MakePolygon(Random& random, int32 count, float32 radius)
+{
+	b2Vec2 points[b2_maxPolygonVertices];
+	float32 slice = 2.0f * b2_pi / count;
+	for (int32 i = 0; i < count; ++i)
+	{
+		float32 angle = slice * (i + random.Next(0.2f, 0.8f));
+		points[i].Set(radius * cosf(angle), radius * sinf(angle));
+	}
+
+	b2PolygonShape polygon;
+	polygon.Set(points, count);
+	return polygon;
+}
+
+static b2Transform MakeTransform(Random& random, float32 maxDistance)
+{
+	b2Transform xf;
+	float32 angle = random.Next(-b2_pi, b2_pi);
+	float32 distance = random.Next(0.0f, maxDistance);
+	xf.Set(distance * b2Vec2(cosf(angle), sinf(angle)), random.Next(-b2_pi, b2_pi));
+	return xf;
+}
+
+class Kernel
+{
+public:
+	Kernel() : m_index(0), m_checksum(0.0) {}
+	virtual ~Kernel() {}
+
+	/// Perform count operations.
+	virtual void Run(int32 count) = 0;
+
+	float64 GetChecksum() const { return m_checksum; }
+
+protected:
+	int32 NextCase()
+	{
+		int32 index = m_index;
+		m_index = (m_index + 1) % b2_caseCount;
+		return index;
+	}
+
+	int32 m_index;
+	float64 m_checksum;
+};
+
+class CollidePolygonsKernel : public Kernel
+{
+public:
+	CollidePolygonsKernel(int32 size, uint32 seed)
+	{
+		Random random(seed);
+		for (int32 i = 0; i < b2_caseCount; ++i)
+		{
+			m_polygonA[i] = MakePolygon(random, size, random.Next(0.5f, 1.5f));
+			m_polygonB[i] = MakePolygon(random, size, random.Next(0.5f, 1.5f));
+			m_xfA[i] = MakeTransform(random, 0.0f);
+			m_xfB[i] = MakeTransform(random, 3.0f);
+		}
+	}
+
+	void Run(int32 count)
+	{
+		b2Manifold manifold;
+		for (int32 i = 0; i < count; ++i)
+		{
+			int32 k = NextCase();
+			b2CollidePolygons(&manifold, m_polygonA + k, m_xfA[k], m_polygonB + k, m_xfB[k]);
+			m_checksum += manifold.pointCount;
+		}
+	}
+
+private:
+	b2PolygonShape m_polygonA[b2_caseCount];
+	b2PolygonShape m_polygonB[b2_caseCount];
+	b2Transform m_xfA[b2_caseCount];
+	b2Transform m_xfB[b2_caseCount];
+};
+
+class CollidePolygonAndCircleKernel : public Kernel
+{
+public:
+	CollidePolygonAndCircleKernel(int32 size, uint32 seed)
+	{
+		Random random(seed);
+		for (int32 i = 0; i < b2_caseCount; ++i)
+		{
+			m_polygon[i] = MakePolygon(random, size, random.Next(0.5f, 1.5f));
+			m_circle[i].m_radius = random.Next(0.25f, 1.0f);
+			m_xfA[i] = MakeTransform(random, 0.0f);
+			m_xfB[i] = MakeTransform(random, 2.5f);
+		}
+	}
+
+	void Run(int32 count)
+	{
+		b2Manifold manifold;
+		for (int32 i = 0; i < count; ++i)
+		{
+			int32 k = NextCase();
+			b2CollidePolygonAndCircle(&manifold, m_polygon + k, m_xfA[k], m_circle + k, m_xfB[k]);
+			m_checksum += manifold.pointCount;
+		}
+	}
+
+private:
+	b2PolygonShape m_polygon[b2_caseCount];
+	b2CircleShape m_circle[b2_caseCount];
+	b2Transform m_xfA[b2_caseCount];
+	b2Transform m_xfB[b2_caseCount];
+};
+
+class CollideEdgeAndPolygonKernel : public Kernel
+{
+public:
+	CollideEdgeAndPolygonKernel(int32 size, uint32 seed)
+	{
+		Random random(seed);
+		for (int32 i = 0; i < b2_caseCount; ++i)
+		{
+			float32 length = random.Next(1.0f, 4.0f);
+			m_edge[i].Set(b2Vec2(-length, 0.0f), b2Vec2(length, 0.0f));
+
+			// Half the edges are part of a chain, which takes the smooth collision paths.
+			if (random.NextUInt() & 1)
+			{
+				m_edge[i].m_vertex0 = b2Vec2(-2.0f * length, random.Next(-1.0f, 1.0f));
+				m_edge[i].m_vertex3 = b2Vec2(2.0f * length, random.Next(-1.0f, 1.0f));
+				m_edge[i].m_hasVertex0 = true;
+				m_edge[i].m_hasVertex3 = true;
+			}
+
+			m_polygon[i] = MakePolygon(random, size, random.Next(0.5f, 1.5f));
+			m_xfA[i] = MakeTransform(random, 0.0f);
+			m_xfB[i] = MakeTransform(random, 2.0f);
+		}
+	}
+
+	void Run(int32 count)
+	{
+		b2Manifold manifold;
+		for (int32 i = 0; i < count; ++i)
+		{
+			int32 k = NextCase();
+			b2CollideEdgeAndPolygon(&manifold, m_edge + k, m_xfA[k], m_polygon + k, m_xfB[k]);
+			m_checksum += manifold.pointCount;
+		}
+	}
+
+private:
+	b2EdgeShape m_edge[b2_caseCount];
+	b2PolygonShape m_polygon[b2_caseCount];
+	b2Transform m_xfA[b2_caseCount];
+	b2Transform m_xfB[b2_caseCount];
+};
+
+class DistanceKernel : public Kernel
+{
+public:
+	DistanceKernel(int32 size, uint32 seed)
+	{
+		Random random(seed);
+		for (int32 i = 0; i < b2_caseCount; ++i)
+		{
+			m_polygonA[i] = MakePolygon(random, size, random.Next(0.5f, 1.5f));
+			m_polygonB[i] = MakePolygon(random, size, random.Next(0.5f, 1.5f));
+
+			b2DistanceInput& input = m_input[i];
+			input.proxyA.Set(m_polygonA + i, 0);
+			input.proxyB.Set(m_polygonB + i, 0);
+			input.transformA = MakeTransform(random, 0.0f);
+			input.transformB = MakeTransform(random, 5.0f);
+			input.useRadii = true;
+		}
+	}
+
+	void Run(int32 count)
+	{
+		b2DistanceOutput output;
+		for (int32 i = 0; i < count; ++i)
+		{
+			int32 k = NextCase();
+
+			// Cold start, as for a new contact.
+			b2SimplexCache cache;
+			cache.count = 0;
+			b2Distance(&output, &cache, m_input + k);
+			m_checksum += output.distance;
+		}
+	}
+
+private:
+	b2PolygonShape m_polygonA[b2_caseCount];
+	b2PolygonShape m_polygonB[b2_caseCount];
+	b2DistanceInput m_input[b2_caseCount];
+};
+
+class TimeOfImpactKernel : public Kernel
+{
+public:
+	TimeOfImpactKernel(int32 size, uint32 seed)
+	{
+		Random random(seed);
+		for (int32 i = 0; i < b2_caseCount; ++i)
+		{
+			m_polygonA[i] = MakePolygon(random, size, random.Next(0.5f, 1.5f));
+			m_polygonB[i] = MakePolygon(random, size, random.Next(0.25f, 0.75f));
+
+			b2TOIInput& input = m_input[i];
+			input.proxyA.Set(m_polygonA + i, 0);
+			input.proxyB.Set(m_polygonB + i, 0);
+
+			b2Sweep& sweepA = input.sweepA;
+			sweepA.localCenter.SetZero();
+			sweepA.c0.SetZero();
+			sweepA.c.SetZero();
+			sweepA.a0 = random.Next(-b2_pi, b2_pi);
+			sweepA.a = sweepA.a0 + random.Next(-0.1f, 0.1f);
+			sweepA.alpha0 = 0.0f;
+
+			// B flies past or through A while spinning.
+			float32 angle = random.Next(-b2_pi, b2_pi);
+			b2Vec2 direction(cosf(angle), sinf(angle));
+			b2Vec2 offset = random.Next(-1.5f, 1.5f) * b2Cross(1.0f, direction);
+
+			b2Sweep& sweepB = input.sweepB;
+			sweepB.localCenter.SetZero();
+			sweepB.c0 = offset - 4.0f * direction;
+			sweepB.c = offset + 4.0f * direction;
+			sweepB.a0 = random.Next(-b2_pi, b2_pi);
+			sweepB.a = sweepB.a0 + random.Next(-2.0f, 2.0f);
+			sweepB.alpha0 = 0.0f;
+
+			input.tMax = 1.0f;
+		}
+	}
+
+	void Run(int32 count)
+	{
+		b2TOIOutput output;
+		for (int32 i = 0; i < count; ++i)
+		{
+			int32 k = NextCase();
+			b2TimeOfImpact(&output, m_input + k);
+			m_checksum += output.t;
+		}
+	}
+
+private:
+	b2PolygonShape m_polygonA[b2_caseCount];
+	b2PolygonShape m_polygonB[b2_caseCount];
+	b2TOIInput m_input[b2_caseCount];
+};
+
+// A tree of size proxies spread so the density is the same at every size.
+class TreeKernel : public Kernel
+{
+public:
+	TreeKernel(int32 size, uint32 seed) : m_random(seed)
+	{
+		m_extent = 2.0f * b2Sqrt(float32(size));
+		m_proxies.resize(size);
+		m_aabbs.resize(size);
+		for (int32 i = 0; i < size; ++i)
+		{
+			b2Vec2 center = m_random.NextVec(-m_extent, m_extent);
+			b2Vec2 extents = m_random.NextVec(0.25f, 0.75f);
+			m_aabbs[i].lowerBound = center - extents;
+			m_aabbs[i].upperBound = center + extents;
+			m_proxies[i] = m_tree.CreateProxy(m_aabbs[i], NULL);
+		}
+	}
+
+	bool QueryCallback(int32 proxyId)
+	{
+		m_checksum += proxyId;
+		return true;
+	}
+
+	float32 RayCastCallback(const b2RayCastInput& input, int32 proxyId)
+	{
+		m_checksum += proxyId;
+		return input.maxFraction;
+	}
+
+protected:
+	b2DynamicTree m_tree;
+	std::vector<int32> m_proxies;
+	std::vector<b2AABB> m_aabbs;
+	float32 m_extent;
+	Random m_random;
+};
+
+class TreeQueryKernel : public TreeKernel
+{
+public:
+	TreeQueryKernel(int32 size, uint32 seed) : TreeKernel(size, seed)
+	{
+		for (int32 i = 0; i < b2_caseCount; ++i)
+		{
+			b2Vec2 center = m_random.NextVec(-m_extent, m_extent);
+			b2Vec2 extents = m_random.NextVec(0.5f, 2.0f);
+			m_queries[i].lowerBound = center - extents;
+			m_queries[i].upperBound = center + extents;
+		}
+	}
+
+	void Run(int32 count)
+	{
+		for (int32 i = 0; i < count; ++i)
+		{
+			m_tree.Query(this, m_queries[NextCase()]);
+		}
+	}
+
+private:
+	b2AABB m_queries[b2_caseCount];
+};
+
+class TreeRayCastKernel : public TreeKernel
+{
+public:
+	TreeRayCastKernel(int32 size, uint32 seed) : TreeKernel(size, seed)
+	{
+		for (int32 i = 0; i < b2_caseCount; ++i)
+		{
+			float32 angle = m_random.Next(-b2_pi, b2_pi);
+			b2RayCastInput& input = m_inputs[i];
+			input.p1 = m_random.NextVec(-m_extent, m_extent);
+			input.p2 = input.p1 + 10.0f * b2Vec2(cosf(angle), sinf(angle));
+			input.maxFraction = 1.0f;
+		}
+	}
+
+	void Run(int32 count)
+	{
+		for (int32 i = 0; i < count; ++i)
+		{
+			m_tree.RayCast(this, m_inputs[NextCase()]);
+		}
+	}
+
+private:
+	b2RayCastInput m_inputs[b2_caseCount];
+};
+
+// Proxies drift and bounce inside the world, so some moves leave the fat AABB
+// and reinsert the leaf.
+class TreeMoveProxyKernel : public TreeKernel
+{
+public:
+	TreeMoveProxyKernel(int32 size, uint32 seed) : TreeKernel(size, seed), m_next(0)
+	{
+		m_velocities.resize(size);
+		for (int32 i = 0; i < size; ++i)
+		{
+			m_velocities[i] = m_random.NextVec(-0.2f, 0.2f);
+		}
+	}
+
+	void Run(int32 count)
+	{
+		int32 proxyCount = int32(m_proxies.size());
+		for (int32 i = 0; i < count; ++i)
+		{
+			int32 k = m_next;
+			m_next = (m_next + 1) % proxyCount;
+
+			b2AABB& aabb = m_aabbs[k];
+			b2Vec2& v = m_velocities[k];
+			if (aabb.lowerBound.x < -m_extent || aabb.upperBound.x > m_extent)
+			{
+				v.x = aabb.lowerBound.x < -m_extent ? b2Abs(v.x) : -b2Abs(v.x);
+			}
+			if (aabb.lowerBound.y < -m_extent || aabb.upperBound.y > m_extent)
+			{
+				v.y = aabb.lowerBound.y < -m_extent ? b2Abs(v.y) : -b2Abs(v.y);
+			}
+
+			aabb.lowerBound += v;
+			aabb.upperBound += v;
+			m_checksum += m_tree.MoveProxy(m_proxies[k], aabb, v) ? 1.0 : 0.0;
+		}
+	}
+
+private:
+	std::vector<b2Vec2> m_velocities;
+	int32 m_next;
+};
+
+class TreeRebuildKernel : public TreeKernel
+{
+public:
+	TreeRebuildKernel(int32 size, uint32 seed) : TreeKernel(size, seed) {}
+
+	void Run(int32 count)
+	{
+		for (int32 i = 0; i < count; ++i)
+		{
+			m_tree.RebuildBottomUp();
+			m_checksum += m_tree.GetHeight();
+		}
+	}
+};
+
+typedef Kernel* KernelCreateFcn(int32 size, uint32 seed);
+
+template<typename T>
+static Kernel* CreateKernel(int32 size, uint32 seed)
+{
+	return new T(size, seed);
+}
+
+#define b2_maxKernelSizes 3
+
+struct KernelEntry
+{
+	const char* name;
+	const char* sizeName;
+	int32 sizes[b2_maxKernelSizes];
+	KernelCreateFcn* createFcn;
+};
+
+// RebuildBottomUp is cubic in the proxy count, so it gets smaller trees.
+static KernelEntry s_kernels[] =
+{
+	{"b2CollidePolygons", "vertices", {3, 4, 8}, CreateKernel<CollidePolygonsKernel>},
+	{"b2CollidePolygonAndCircle", "vertices", {3, 4, 8}, CreateKernel<CollidePolygonAndCircleKernel>},
+	{"b2CollideEdgeAndPolygon", "vertices", {3, 4, 8}, CreateKernel<CollideEdgeAndPolygonKernel>},
+	{"b2Distance", "vertices", {3, 4, 8}, CreateKernel<DistanceKernel>},
+	{"b2TimeOfImpact", "vertices", {3, 4, 8}, CreateKernel<TimeOfImpactKernel>},
+	{"b2DynamicTree::Query", "proxies", {1000, 10000, 100000}, CreateKernel<TreeQueryKernel>},
+	{"b2DynamicTree::RayCast", "proxies", {1000, 10000, 100000}, CreateKernel<TreeRayCastKernel>},
+	{"b2DynamicTree::MoveProxy", "proxies", {1000, 10000, 100000}, CreateKernel<TreeMoveProxyKernel>},
+	{"b2DynamicTree::RebuildBottomUp", "proxies", {64, 128, 256}, CreateKernel<TreeRebuildKernel>},
+	{NULL, NULL, {0, 0, 0}, NULL}
+};
+
+struct Options
+{
+	const char* filter;
+	uint32 seed;
+	int32 samples;
+	float32 sampleTime;
+	const char* json;
+};
+
+struct KernelResult
+{
+	const char* name;
+	const char* sizeName;
+	int32 size;
+	float64 operations;
+	float64 nsPerOp;
+	float64 minNsPerOp;
+	float64 allocsPerOp;
+};
+
+static void PrintUsage()
+{
+	printf("Usage: MicroBenchmark [--filter TEXT] [--seed N] [--samples N] [--time MS] [--json FILE]\n");
+	printf("  --filter TEXT  run only kernels whose name contains TEXT\n");
+	printf("  --seed N       seed for the random inputs (default 1)\n");
+	printf("  --samples N    timed samples per kernel and size (default 5)\n");
+	printf("  --time MS      minimum duration of one sample (default 20)\n");
+	printf("  --json FILE    also write the results as JSON to FILE\n");
+	printf("Kernels:\n");
+	for (KernelEntry* entry = s_kernels; entry->createFcn; ++entry)
+	{
+		printf("  %s\n", entry->name);
+	}
+}
+
+static bool ParseOptions(int argc, char** argv, Options* options)
+{
+	options->filter = NULL;
+	options->seed = 1;
+	options->samples = 5;
+	options->sampleTime = 20.0f;
+	options->json = NULL;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (strcmp(arg, "--filter") == 0 && hasValue)
+		{
+			options->filter = argv[++i];
+		}
+		else if (strcmp(arg, "--seed") == 0 && hasValue)
+		{
+			options->seed = uint32(strtoul(argv[++i], NULL, 10));
+		}
+		else if (strcmp(arg, "--samples") == 0 && hasValue)
+		{
+			options->samples = b2Max(atoi(argv[++i]), 1);
+		}
+		else if (strcmp(arg, "--time") == 0 && hasValue)
+		{
+			options->sampleTime = b2Max(float32(atof(argv[++i])), 1.0f);
+		}
+		else if (strcmp(arg, "--json") == 0 && hasValue)
+		{
+			options->json = argv[++i];
+		}
+		else
+		{
+			PrintUsage();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static KernelResult RunKernel(const KernelEntry* entry, int32 size, const Options& options)
+{
+	Kernel* kernel = entry->createFcn(size, options.seed);
+
+	// Double the batch until one batch fills a sample. This also warms the caches.
+	int32 batch = 1;
+	for (;;)
+	{
+		b2Timer timer;
+		kernel->Run(batch);
+		if (timer.GetMilliseconds() >= options.sampleTime || batch >= (1 << 30))
+		{
+			break;
+		}
+		batch *= 2;
+	}
+
+	std::vector<float64> samples;
+	int32 allocCount = s_allocCount;
+	for (int32 i = 0; i < options.samples; ++i)
+	{
+		b2Timer timer;
+		kernel->Run(batch);
+		samples.push_back(1.0e6 * timer.GetMilliseconds() / batch);
+	}
+	allocCount = s_allocCount - allocCount;
+
+	s_sink = s_sink + kernel->GetChecksum();
+	delete kernel;
+
+	std::sort(samples.begin(), samples.end());
+
+	KernelResult result;
+	result.name = entry->name;
+	result.sizeName = entry->sizeName;
+	result.size = size;
+	result.operations = float64(batch) * options.samples;
+	result.nsPerOp = samples[samples.size() / 2];
+	result.minNsPerOp = samples.front();
+	result.allocsPerOp = float64(allocCount) / result.operations;
+	return result;
+}
+
+static void WriteJson(FILE* file, const Options& options, const std::vector<KernelResult>& results)
+{
+	fprintf(file, "{\n");
+	fprintf(file, "  \"seed\": %u,\n", options.seed);
+	fprintf(file, "  \"samples\": %d,\n", options.samples);
+	fprintf(file, "  \"kernels\": [\n");
+
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const KernelResult& r = results[i];
+		fprintf(file, "    { \"name\": \"%s\", \"%s\": %d, \"operations\": %.0f, \"nsPerOp\": %.3f, \"minNsPerOp\": %.3f, \"allocsPerOp\": %.4f }%s\n",
+			r.name, r.sizeName, r.size, r.operations, r.nsPerOp, r.minNsPerOp, r.allocsPerOp,
+			i + 1 < results.size() ? "," : "");
+	}
+
+	fprintf(file, "  ]\n");
+	fprintf(file, "}\n");
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (ParseOptions(argc, argv, &options) == false)
+	{
+		return 1;
+	}
+
+	b2SetAllocator(CountingAlloc, CountingFree);
+
+	printf("%-32s %10s %12s %12s %12s\n", "kernel", "size", "ns/op", "min ns/op", "allocs/op");
+
+	std::vector<KernelResult> results;
+	for (KernelEntry* entry = s_kernels; entry->createFcn; ++entry)
+	{
+		if (options.filter && strstr(entry->name, options.filter) == NULL)
+		{
+			continue;
+		}
+
+		for (int32 i = 0; i < b2_maxKernelSizes; ++i)
+		{
+			KernelResult r = RunKernel(entry, entry->sizes[i], options);
+			printf("%-32s %10d %12.2f %12.2f %12.4f\n", r.name, r.size, r.nsPerOp, r.minNsPerOp, r.allocsPerOp);
+			fflush(stdout);
+			results.push_back(r);
+		}
+	}
+
+	if (results.empty())
+	{
+		fprintf(stderr, "No kernels match %s\n", options.filter);
+		return 1;
+	}
+
+	if (options.json)
+	{
+		FILE* file = fopen(options.json, "w");
+		if (file == NULL)
+		{
+			fprintf(stderr, "Cannot open %s\n", options.json);
+			return 1;
+		}
+
+		WriteJson(file, options, results);
+		fclose(file);
+	}
+
+	b2SetAllocator(nullptr, nullptr);
+	return 0;
+}
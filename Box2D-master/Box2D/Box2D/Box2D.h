@@ -33,7 +33,9 @@ For discussion please visit http://box2d.org/forum
 
 #include "Box2D/Common/b2Settings.h"
 #include "Box2D/Common/b2Draw.h"
+#include "Box2D/Common/b2TaskScheduler.h"
 #include "Box2D/Common/b2Timer.h"
+#include "Box2D/Common/b2WorkStealingScheduler.h"
 
 #include "Box2D/Collision/Shapes/b2CircleShape.h"
 #include "Box2D/Collision/Shapes/b2EdgeShape.h"
@@ -17,6 +17,98 @@
 */
 
 #include "Box2D/Collision/b2BroadPhase.h"
+#include "Box2D/Common/b2TaskScheduler.h"
+
+// Pairs found by one thread in FindPairs.
+struct b2PairBuffer
+{
+	b2Pair* pairs;
+	int32 count;
+	int32 capacity;
+};
+
+// Collects the pairs of one moving proxy into a thread's buffer.
+struct b2PairQuery
+{
+	bool QueryCallback(int32 proxyId)
+	{
+		// A proxy cannot form a pair with itself.
+		if (proxyId == queryProxyId)
+		{
+			return true;
+		}
+
+		// Grow the pair buffer as needed.
+		if (buffer->count == buffer->capacity)
+		{
+			b2Pair* oldPairs = buffer->pairs;
+			buffer->capacity *= 2;
+			buffer->pairs = (b2Pair*)b2Alloc(buffer->capacity * sizeof(b2Pair));
+			memcpy(buffer->pairs, oldPairs, buffer->count * sizeof(b2Pair));
+			b2Free(oldPairs);
+		}
+
+		buffer->pairs[buffer->count].proxyIdA = b2Min(proxyId, queryProxyId);
+		buffer->pairs[buffer->count].proxyIdB = b2Max(proxyId, queryProxyId);
+		++buffer->count;
+
+		return true;
+	}
+
+	b2PairBuffer* buffer;
+	int32 queryProxyId;
+};
+
+// Byte digit of a pair for radix sorting. Digits 0-3 are proxy B from least
+// significant and 4-7 are proxy A, so sorting on digits 0 to 7 gives the same
+// order as b2PairLessThan. Proxy ids are never negative.
+static inline int32 b2PairDigit(const b2Pair& pair, int32 digit)
+{
+	uint32 id = (uint32)(digit < 4 ? pair.proxyIdB : pair.proxyIdA);
+	return (id >> (8 * (digit & 3))) & 0xFF;
+}
+
+// Least significant digit radix sort. Digits that are the same for every pair,
+// such as the high bytes of small proxy ids, are skipped.
+static void b2SortPairs(b2Pair* pairs, b2Pair* scratch, int32 count)
+{
+	b2Pair* source = pairs;
+	b2Pair* target = scratch;
+
+	for (int32 digit = 0; digit < 8; ++digit)
+	{
+		int32 offsets[256] = {0};
+		for (int32 i = 0; i < count; ++i)
+		{
+			++offsets[b2PairDigit(source[i], digit)];
+		}
+
+		if (offsets[b2PairDigit(source[0], digit)] == count)
+		{
+			continue;
+		}
+
+		int32 sum = 0;
+		for (int32 i = 0; i < 256; ++i)
+		{
+			int32 n = offsets[i];
+			offsets[i] = sum;
+			sum += n;
+		}
+
+		for (int32 i = 0; i < count; ++i)
+		{
+			target[offsets[b2PairDigit(source[i], digit)]++] = source[i];
+		}
+
+		b2Swap(source, target);
+	}
+
+	if (source != pairs)
+	{
+		memcpy(pairs, source, count * sizeof(b2Pair));
+	}
+}
 
 b2BroadPhase::b2BroadPhase()
 {
@@ -29,10 +121,22 @@ b2BroadPhase::b2BroadPhase()
 	m_moveCapacity = 16;
 	m_moveCount = 0;
 	m_moveBuffer = (int32*)b2Alloc(m_moveCapacity * sizeof(int32));
+
+	m_threadPairs = nullptr;
+	m_threadPairCount = 0;
+	m_sortBuffer = nullptr;
+	m_sortCapacity = 0;
 }
 
 b2BroadPhase::~b2BroadPhase()
 {
+	for (int32 i = 0; i < m_threadPairCount; ++i)
+	{
+		b2Free(m_threadPairs[i].pairs);
+	}
+	b2Free(m_threadPairs);
+	b2Free(m_sortBuffer);
+
 	b2Free(m_moveBuffer);
 	b2Free(m_pairBuffer);
 }
@@ -52,6 +156,14 @@ void b2BroadPhase::DestroyProxy(int32 proxyId)
 	m_tree.DestroyProxy(proxyId);
 }
 
+void b2BroadPhase::Clear()
+{
+	m_tree.Clear();
+	m_proxyCount = 0;
+	m_moveCount = 0;
+	m_pairCount = 0;
+}
+
 void b2BroadPhase::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
 {
 	bool buffer = m_tree.MoveProxy(proxyId, aabb, displacement);
@@ -117,3 +229,87 @@ bool b2BroadPhase::QueryCallback(int32 proxyId)
 
 	return true;
 }
+
+void b2BroadPhase::FindPairsTask(int32 begin, int32 end, int32 threadIndex, void* context)
+{
+	b2BroadPhase* broadPhase = (b2BroadPhase*)context;
+	const b2DynamicTree* tree = &broadPhase->m_tree;
+
+	b2PairQuery query;
+	query.buffer = broadPhase->m_threadPairs + threadIndex;
+
+	for (int32 i = begin; i < end; ++i)
+	{
+		query.queryProxyId = broadPhase->m_moveBuffer[i];
+		if (query.queryProxyId == e_nullProxy)
+		{
+			continue;
+		}
+
+		// We have to query the tree with the fat AABB so that
+		// we don't fail to create a pair that may touch later.
+		tree->Query(&query, tree->GetFatAABB(query.queryProxyId));
+	}
+}
+
+void b2BroadPhase::FindPairs(b2TaskScheduler* scheduler)
+{
+	int32 threadCount = scheduler->GetThreadCount();
+	if (threadCount > m_threadPairCount)
+	{
+		b2PairBuffer* oldBuffers = m_threadPairs;
+		m_threadPairs = (b2PairBuffer*)b2Alloc(threadCount * sizeof(b2PairBuffer));
+		memcpy(m_threadPairs, oldBuffers, m_threadPairCount * sizeof(b2PairBuffer));
+		b2Free(oldBuffers);
+
+		for (int32 i = m_threadPairCount; i < threadCount; ++i)
+		{
+			m_threadPairs[i].capacity = 16;
+			m_threadPairs[i].pairs = (b2Pair*)b2Alloc(m_threadPairs[i].capacity * sizeof(b2Pair));
+		}
+		m_threadPairCount = threadCount;
+	}
+
+	for (int32 i = 0; i < m_threadPairCount; ++i)
+	{
+		m_threadPairs[i].count = 0;
+	}
+
+	b2TaskHandle handle = scheduler->ParallelFor(m_moveCount, 16, FindPairsTask, this);
+	scheduler->Wait(handle);
+
+	// Gather the thread buffers. Which thread found a pair depends on
+	// scheduling, but sorting makes the final order deterministic.
+	m_pairCount = 0;
+	for (int32 i = 0; i < m_threadPairCount; ++i)
+	{
+		m_pairCount += m_threadPairs[i].count;
+	}
+
+	if (m_pairCount > m_pairCapacity)
+	{
+		b2Free(m_pairBuffer);
+		m_pairCapacity = b2Max(m_pairCount, 2 * m_pairCapacity);
+		m_pairBuffer = (b2Pair*)b2Alloc(m_pairCapacity * sizeof(b2Pair));
+	}
+
+	if (m_pairCount > m_sortCapacity)
+	{
+		b2Free(m_sortBuffer);
+		m_sortCapacity = m_pairCapacity;
+		m_sortBuffer = (b2Pair*)b2Alloc(m_sortCapacity * sizeof(b2Pair));
+	}
+
+	int32 pairCount = 0;
+	for (int32 i = 0; i < m_threadPairCount; ++i)
+	{
+		const b2PairBuffer* buffer = m_threadPairs + i;
+		memcpy(m_pairBuffer + pairCount, buffer->pairs, buffer->count * sizeof(b2Pair));
+		pairCount += buffer->count;
+	}
+
+	if (m_pairCount > 0)
+	{
+		b2SortPairs(m_pairBuffer, m_sortBuffer, m_pairCount);
+	}
+}
@@ -173,6 +173,22 @@ protected:
 		e_toiFlag			= 0x0020
 	};
 
+	// Events returned by UpdateManifold
+	enum
+	{
+		// The bodies must be woken because the touching state changed.
+		e_wakeEvent			= 0x0001,
+
+		// The listener gets BeginContact.
+		e_beginEvent		= 0x0002,
+
+		// The listener gets EndContact.
+		e_endEvent			= 0x0004,
+
+		// The listener gets PreSolve.
+		e_preSolveEvent		= 0x0008
+	};
+
 	/// Flag this contact for filtering. Filtering will occur the next time step.
 	void FlagForFiltering();
 
@@ -189,6 +205,12 @@ protected:
 
 	void Update(b2ContactListener* listener);
 
+	// Update the manifold and touching flag without waking bodies or calling
+	// the listener, so contacts can be updated concurrently. Returns the
+	// events to pass to ReportUpdate along with the old manifold.
+	uint32 UpdateManifold(b2Manifold* oldManifold);
+	void ReportUpdate(uint32 events, const b2Manifold* oldManifold, b2ContactListener* listener);
+
 	static b2ContactRegister s_registers[b2Shape::e_typeCount][b2Shape::e_typeCount];
 	static bool s_initialized;
 
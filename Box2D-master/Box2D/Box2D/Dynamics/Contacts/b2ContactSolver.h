@@ -26,6 +26,7 @@
 class b2Contact;
 class b2Body;
 class b2StackAllocator;
+class b2WideContactSolver;
 struct b2ContactPositionConstraint;
 
 struct b2VelocityConstraintPoint
@@ -89,6 +90,7 @@ public:
 	b2ContactVelocityConstraint* m_velocityConstraints;
 	b2Contact** m_contacts;
 	int m_count;
+	b2WideContactSolver* m_wideSolver;
 };
 
 #endif
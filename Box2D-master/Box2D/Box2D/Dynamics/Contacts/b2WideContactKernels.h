@@ -0,0 +1,435 @@
+/*
+* Copyright (c) 2006-2011 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef B2_WIDE_CONTACT_KERNELS_H
+#define B2_WIDE_CONTACT_KERNELS_H
+
+#include "Box2D/Dynamics/Contacts/b2ContactSolver.h"
+#include <string.h>
+
+// Kernels shared by the instruction set specific parts of b2WideContactSolver.
+// They are templates on a SIMD float type W with W::width lanes, which must
+// provide Load, Splat and Zero, the arithmetic operators and b2StoreW, b2MinW,
+// b2MaxW, b2GreaterEqualW, b2AndW and b2SelectW.
+
+// Contact velocity constraints in structure of arrays form, one per lane.
+// Lanes of single point constraints have zero second point data.
+template <int32 N>
+struct b2ContactBatch
+{
+	// Index of the b2ContactVelocityConstraint, -1 if the lane is empty.
+	int32 constraint[N];
+	int32 indexA[N];
+	int32 indexB[N];
+	float32 invMassA[N], invIA[N];
+	float32 invMassB[N], invIB[N];
+	float32 normalX[N], normalY[N];
+	float32 friction[N];
+	float32 tangentSpeed[N];
+
+	float32 rA1X[N], rA1Y[N], rB1X[N], rB1Y[N];
+	float32 normalMass1[N], tangentMass1[N], velocityBias1[N];
+	float32 normalImpulse1[N], tangentImpulse1[N];
+
+	float32 rA2X[N], rA2Y[N], rB2X[N], rB2Y[N];
+	float32 normalMass2[N], tangentMass2[N], velocityBias2[N];
+	float32 normalImpulse2[N], tangentImpulse2[N];
+
+	// Block solver matrices K and inverse K. The block flag is 1 for
+	// constraints with two points and 0 otherwise.
+	float32 k11[N], k12[N], k22[N];
+	float32 m11[N], m12[N], m21[N], m22[N];
+	float32 block[N];
+};
+
+template <int32 N>
+void b2PackContactBatches(void* batches, const int32* lanes, int32 batchCount, const b2ContactVelocityConstraint* constraints)
+{
+	b2ContactBatch<N>* batch = (b2ContactBatch<N>*)batches;
+	for (int32 i = 0; i < batchCount; ++i, ++batch)
+	{
+		memset(batch, 0, sizeof(b2ContactBatch<N>));
+
+		for (int32 j = 0; j < N; ++j)
+		{
+			int32 index = lanes[i * N + j];
+			batch->constraint[j] = index;
+			if (index < 0)
+			{
+				continue;
+			}
+
+			const b2ContactVelocityConstraint* vc = constraints + index;
+			const b2VelocityConstraintPoint* cp1 = vc->points + 0;
+			const b2VelocityConstraintPoint* cp2 = vc->points + 1;
+
+			batch->indexA[j] = vc->indexA;
+			batch->indexB[j] = vc->indexB;
+			batch->invMassA[j] = vc->invMassA;
+			batch->invIA[j] = vc->invIA;
+			batch->invMassB[j] = vc->invMassB;
+			batch->invIB[j] = vc->invIB;
+			batch->normalX[j] = vc->normal.x;
+			batch->normalY[j] = vc->normal.y;
+			batch->friction[j] = vc->friction;
+			batch->tangentSpeed[j] = vc->tangentSpeed;
+
+			batch->rA1X[j] = cp1->rA.x;
+			batch->rA1Y[j] = cp1->rA.y;
+			batch->rB1X[j] = cp1->rB.x;
+			batch->rB1Y[j] = cp1->rB.y;
+			batch->normalMass1[j] = cp1->normalMass;
+			batch->tangentMass1[j] = cp1->tangentMass;
+			batch->velocityBias1[j] = cp1->velocityBias;
+			batch->normalImpulse1[j] = cp1->normalImpulse;
+			batch->tangentImpulse1[j] = cp1->tangentImpulse;
+
+			if (vc->pointCount == 2)
+			{
+				batch->rA2X[j] = cp2->rA.x;
+				batch->rA2Y[j] = cp2->rA.y;
+				batch->rB2X[j] = cp2->rB.x;
+				batch->rB2Y[j] = cp2->rB.y;
+				batch->normalMass2[j] = cp2->normalMass;
+				batch->tangentMass2[j] = cp2->tangentMass;
+				batch->velocityBias2[j] = cp2->velocityBias;
+				batch->normalImpulse2[j] = cp2->normalImpulse;
+				batch->tangentImpulse2[j] = cp2->tangentImpulse;
+
+				batch->k11[j] = vc->K.ex.x;
+				batch->k12[j] = vc->K.ey.x;
+				batch->k22[j] = vc->K.ey.y;
+				batch->m11[j] = vc->normalMass.ex.x;
+				batch->m12[j] = vc->normalMass.ey.x;
+				batch->m21[j] = vc->normalMass.ex.y;
+				batch->m22[j] = vc->normalMass.ey.y;
+				batch->block[j] = 1.0f;
+			}
+		}
+	}
+}
+
+template <int32 N>
+void b2StoreContactBatches(const void* batches, int32 batchCount, b2ContactVelocityConstraint* constraints)
+{
+	const b2ContactBatch<N>* batch = (const b2ContactBatch<N>*)batches;
+	for (int32 i = 0; i < batchCount; ++i, ++batch)
+	{
+		for (int32 j = 0; j < N; ++j)
+		{
+			int32 index = batch->constraint[j];
+			if (index < 0)
+			{
+				continue;
+			}
+
+			b2ContactVelocityConstraint* vc = constraints + index;
+			vc->points[0].normalImpulse = batch->normalImpulse1[j];
+			vc->points[0].tangentImpulse = batch->tangentImpulse1[j];
+
+			if (vc->pointCount == 2)
+			{
+				vc->points[1].normalImpulse = batch->normalImpulse2[j];
+				vc->points[1].tangentImpulse = batch->tangentImpulse2[j];
+			}
+		}
+	}
+}
+
+// Velocities of one body per lane.
+template <typename W>
+struct b2BodyW
+{
+	W vx, vy, w;
+};
+
+template <typename W>
+inline b2BodyW<W> b2GatherBodies(const int32* constraint, const int32* index, const b2Velocity* velocities)
+{
+	float32 vx[W::width], vy[W::width], w[W::width];
+	for (int32 i = 0; i < W::width; ++i)
+	{
+		if (constraint[i] < 0)
+		{
+			vx[i] = 0.0f;
+			vy[i] = 0.0f;
+			w[i] = 0.0f;
+			continue;
+		}
+
+		const b2Velocity* v = velocities + index[i];
+		vx[i] = v->v.x;
+		vy[i] = v->v.y;
+		w[i] = v->w;
+	}
+
+	b2BodyW<W> body;
+	body.vx = W::Load(vx);
+	body.vy = W::Load(vy);
+	body.w = W::Load(w);
+	return body;
+}
+
+// Lanes never share a dynamic body. They may share a static or kinematic
+// body, whose velocity the solver leaves unchanged.
+template <typename W>
+inline void b2ScatterBodies(const b2BodyW<W>& body, const int32* constraint, const int32* index, b2Velocity* velocities)
+{
+	float32 vx[W::width], vy[W::width], w[W::width];
+	b2StoreW(vx, body.vx);
+	b2StoreW(vy, body.vy);
+	b2StoreW(w, body.w);
+
+	for (int32 i = 0; i < W::width; ++i)
+	{
+		if (constraint[i] < 0)
+		{
+			continue;
+		}
+
+		b2Velocity* v = velocities + index[i];
+		v->v.x = vx[i];
+		v->v.y = vy[i];
+		v->w = w[i];
+	}
+}
+
+// Apply the impulse P at the anchors rA and rB, as in b2ContactSolver.
+template <typename W>
+inline void b2ApplyImpulseW(b2BodyW<W>* bodyA, b2BodyW<W>* bodyB, W mA, W iA, W mB, W iB,
+							W rAX, W rAY, W rBX, W rBY, W PX, W PY)
+{
+	bodyA->vx = bodyA->vx - mA * PX;
+	bodyA->vy = bodyA->vy - mA * PY;
+	bodyA->w = bodyA->w - iA * (rAX * PY - rAY * PX);
+
+	bodyB->vx = bodyB->vx + mB * PX;
+	bodyB->vy = bodyB->vy + mB * PY;
+	bodyB->w = bodyB->w + iB * (rBX * PY - rBY * PX);
+}
+
+template <typename W>
+void b2WarmStartContactBatches(void* batches, int32 batchCount, b2Velocity* velocities)
+{
+	b2ContactBatch<W::width>* batch = (b2ContactBatch<W::width>*)batches;
+	for (int32 i = 0; i < batchCount; ++i, ++batch)
+	{
+		b2BodyW<W> bodyA = b2GatherBodies<W>(batch->constraint, batch->indexA, velocities);
+		b2BodyW<W> bodyB = b2GatherBodies<W>(batch->constraint, batch->indexB, velocities);
+
+		W mA = W::Load(batch->invMassA);
+		W iA = W::Load(batch->invIA);
+		W mB = W::Load(batch->invMassB);
+		W iB = W::Load(batch->invIB);
+
+		W normalX = W::Load(batch->normalX);
+		W normalY = W::Load(batch->normalY);
+		W tangentX = normalY;
+		W tangentY = W::Zero() - normalX;
+
+		{
+			W normalImpulse = W::Load(batch->normalImpulse1);
+			W tangentImpulse = W::Load(batch->tangentImpulse1);
+			W PX = normalImpulse * normalX + tangentImpulse * tangentX;
+			W PY = normalImpulse * normalY + tangentImpulse * tangentY;
+			b2ApplyImpulseW(&bodyA, &bodyB, mA, iA, mB, iB,
+							W::Load(batch->rA1X), W::Load(batch->rA1Y), W::Load(batch->rB1X), W::Load(batch->rB1Y), PX, PY);
+		}
+
+		{
+			W normalImpulse = W::Load(batch->normalImpulse2);
+			W tangentImpulse = W::Load(batch->tangentImpulse2);
+			W PX = normalImpulse * normalX + tangentImpulse * tangentX;
+			W PY = normalImpulse * normalY + tangentImpulse * tangentY;
+			b2ApplyImpulseW(&bodyA, &bodyB, mA, iA, mB, iB,
+							W::Load(batch->rA2X), W::Load(batch->rA2Y), W::Load(batch->rB2X), W::Load(batch->rB2Y), PX, PY);
+		}
+
+		b2ScatterBodies(bodyA, batch->constraint, batch->indexA, velocities);
+		b2ScatterBodies(bodyB, batch->constraint, batch->indexB, velocities);
+	}
+}
+
+// Friction for one point, see b2ContactSolver::SolveVelocityConstraints.
+template <typename W>
+inline void b2SolveTangentW(b2BodyW<W>* bodyA, b2BodyW<W>* bodyB, W mA, W iA, W mB, W iB,
+							W tangentX, W tangentY, W friction, W tangentSpeed,
+							const float32* rAX, const float32* rAY, const float32* rBX, const float32* rBY,
+							const float32* tangentMass, const float32* normalImpulse, float32* tangentImpulse)
+{
+	W rAx = W::Load(rAX);
+	W rAy = W::Load(rAY);
+	W rBx = W::Load(rBX);
+	W rBy = W::Load(rBY);
+
+	// Relative velocity at contact
+	W dvX = bodyB->vx - bodyB->w * rBy - bodyA->vx + bodyA->w * rAy;
+	W dvY = bodyB->vy + bodyB->w * rBx - bodyA->vy - bodyA->w * rAx;
+
+	// Compute tangent force
+	W vt = dvX * tangentX + dvY * tangentY - tangentSpeed;
+	W lambda = W::Load(tangentMass) * (W::Zero() - vt);
+
+	// Clamp the accumulated force
+	W maxFriction = friction * W::Load(normalImpulse);
+	W oldImpulse = W::Load(tangentImpulse);
+	W newImpulse = b2MaxW(W::Zero() - maxFriction, b2MinW(oldImpulse + lambda, maxFriction));
+	lambda = newImpulse - oldImpulse;
+	b2StoreW(tangentImpulse, newImpulse);
+
+	// Apply contact impulse
+	b2ApplyImpulseW(bodyA, bodyB, mA, iA, mB, iB, rAx, rAy, rBx, rBy, lambda * tangentX, lambda * tangentY);
+}
+
+// Solves the normal constraints of two point lanes with the block solver and
+// single point lanes directly. All four cases of the block solver are
+// evaluated and the first valid one is selected per lane.
+template <typename W>
+void b2SolveContactBatches(void* batches, int32 batchCount, b2Velocity* velocities)
+{
+	b2ContactBatch<W::width>* batch = (b2ContactBatch<W::width>*)batches;
+	for (int32 i = 0; i < batchCount; ++i, ++batch)
+	{
+		b2BodyW<W> bodyA = b2GatherBodies<W>(batch->constraint, batch->indexA, velocities);
+		b2BodyW<W> bodyB = b2GatherBodies<W>(batch->constraint, batch->indexB, velocities);
+
+		W mA = W::Load(batch->invMassA);
+		W iA = W::Load(batch->invIA);
+		W mB = W::Load(batch->invMassB);
+		W iB = W::Load(batch->invIB);
+
+		W normalX = W::Load(batch->normalX);
+		W normalY = W::Load(batch->normalY);
+		W tangentX = normalY;
+		W tangentY = W::Zero() - normalX;
+		W friction = W::Load(batch->friction);
+		W tangentSpeed = W::Load(batch->tangentSpeed);
+
+		// Solve tangent constraints first because non-penetration is more important
+		// than friction.
+		b2SolveTangentW(&bodyA, &bodyB, mA, iA, mB, iB, tangentX, tangentY, friction, tangentSpeed,
+						batch->rA1X, batch->rA1Y, batch->rB1X, batch->rB1Y,
+						batch->tangentMass1, batch->normalImpulse1, batch->tangentImpulse1);
+		b2SolveTangentW(&bodyA, &bodyB, mA, iA, mB, iB, tangentX, tangentY, friction, tangentSpeed,
+						batch->rA2X, batch->rA2Y, batch->rB2X, batch->rB2Y,
+						batch->tangentMass2, batch->normalImpulse2, batch->tangentImpulse2);
+
+		W rA1X = W::Load(batch->rA1X);
+		W rA1Y = W::Load(batch->rA1Y);
+		W rB1X = W::Load(batch->rB1X);
+		W rB1Y = W::Load(batch->rB1Y);
+		W rA2X = W::Load(batch->rA2X);
+		W rA2Y = W::Load(batch->rA2Y);
+		W rB2X = W::Load(batch->rB2X);
+		W rB2Y = W::Load(batch->rB2Y);
+
+		W a1 = W::Load(batch->normalImpulse1);
+		W a2 = W::Load(batch->normalImpulse2);
+
+		// Relative normal velocity at the contacts
+		W dv1X = bodyB.vx - bodyB.w * rB1Y - bodyA.vx + bodyA.w * rA1Y;
+		W dv1Y = bodyB.vy + bodyB.w * rB1X - bodyA.vy - bodyA.w * rA1X;
+		W dv2X = bodyB.vx - bodyB.w * rB2Y - bodyA.vx + bodyA.w * rA2Y;
+		W dv2Y = bodyB.vy + bodyB.w * rB2X - bodyA.vy - bodyA.w * rA2X;
+		W vn1 = dv1X * normalX + dv1Y * normalY;
+		W vn2 = dv2X * normalX + dv2Y * normalY;
+
+		W zero = W::Zero();
+		W normalMass1 = W::Load(batch->normalMass1);
+		W normalMass2 = W::Load(batch->normalMass2);
+		W bias1 = W::Load(batch->velocityBias1);
+		W bias2 = W::Load(batch->velocityBias2);
+		W k12 = W::Load(batch->k12);
+
+		// Compute b' = b - K * a
+		W bX = vn1 - bias1 - (W::Load(batch->k11) * a1 + k12 * a2);
+		W bY = vn2 - bias2 - (k12 * a1 + W::Load(batch->k22) * a2);
+
+		// If no case is valid the impulse is unchanged.
+		W x1 = a1;
+		W x2 = a2;
+
+		// Case 4: x1 = 0 and x2 = 0
+		{
+			W valid = b2AndW(b2GreaterEqualW(bX, zero), b2GreaterEqualW(bY, zero));
+			x1 = b2SelectW(valid, zero, x1);
+			x2 = b2SelectW(valid, zero, x2);
+		}
+
+		// Case 3: vn2 = 0 and x1 = 0
+		{
+			W c2 = zero - normalMass2 * bY;
+			W c1vn = k12 * c2 + bX;
+			W valid = b2AndW(b2GreaterEqualW(c2, zero), b2GreaterEqualW(c1vn, zero));
+			x1 = b2SelectW(valid, zero, x1);
+			x2 = b2SelectW(valid, c2, x2);
+		}
+
+		// Case 2: vn1 = 0 and x2 = 0
+		{
+			W c1 = zero - normalMass1 * bX;
+			W c2vn = k12 * c1 + bY;
+			W valid = b2AndW(b2GreaterEqualW(c1, zero), b2GreaterEqualW(c2vn, zero));
+			x1 = b2SelectW(valid, c1, x1);
+			x2 = b2SelectW(valid, zero, x2);
+		}
+
+		// Case 1: vn = 0
+		{
+			W c1 = zero - (W::Load(batch->m11) * bX + W::Load(batch->m12) * bY);
+			W c2 = zero - (W::Load(batch->m21) * bX + W::Load(batch->m22) * bY);
+			W valid = b2AndW(b2GreaterEqualW(c1, zero), b2GreaterEqualW(c2, zero));
+			x1 = b2SelectW(valid, c1, x1);
+			x2 = b2SelectW(valid, c2, x2);
+		}
+
+		// Single point lanes
+		{
+			W single = b2MaxW(a1 - normalMass1 * (vn1 - bias1), zero);
+			W block = b2GreaterEqualW(W::Load(batch->block), W::Splat(0.5f));
+			x1 = b2SelectW(block, x1, single);
+			x2 = b2SelectW(block, x2, a2);
+		}
+
+		// Apply incremental impulse
+		W d1 = x1 - a1;
+		W d2 = x2 - a2;
+		W P1X = d1 * normalX;
+		W P1Y = d1 * normalY;
+		W P2X = d2 * normalX;
+		W P2Y = d2 * normalY;
+
+		bodyA.vx = bodyA.vx - mA * (P1X + P2X);
+		bodyA.vy = bodyA.vy - mA * (P1Y + P2Y);
+		bodyA.w = bodyA.w - iA * ((rA1X * P1Y - rA1Y * P1X) + (rA2X * P2Y - rA2Y * P2X));
+
+		bodyB.vx = bodyB.vx + mB * (P1X + P2X);
+		bodyB.vy = bodyB.vy + mB * (P1Y + P2Y);
+		bodyB.w = bodyB.w + iB * ((rB1X * P1Y - rB1Y * P1X) + (rB2X * P2Y - rB2Y * P2X));
+
+		// Accumulate
+		b2StoreW(batch->normalImpulse1, x1);
+		b2StoreW(batch->normalImpulse2, x2);
+
+		b2ScatterBodies(bodyA, batch->constraint, batch->indexA, velocities);
+		b2ScatterBodies(bodyB, batch->constraint, batch->indexB, velocities);
+	}
+}
+
+#endif
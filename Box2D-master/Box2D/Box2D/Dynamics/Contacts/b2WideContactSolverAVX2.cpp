@@ -0,0 +1,82 @@
+/*
+* Copyright (c) 2006-2011 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "Box2D/Dynamics/Contacts/b2WideContactSolver.h"
+#include "Box2D/Dynamics/Contacts/b2ContactSolver.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <immintrin.h>
+
+// Everything below is compiled for AVX2 and only called after
+// b2WideContactSolver::GetKernels has checked the CPU. Headers are included
+// above so that their inline functions are not compiled for AVX2.
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+struct b2FloatW8
+{
+	enum { width = 8 };
+
+	static b2FloatW8 Load(const float32* p) { b2FloatW8 r; r.v = _mm256_loadu_ps(p); return r; }
+	static b2FloatW8 Splat(float32 x) { b2FloatW8 r; r.v = _mm256_set1_ps(x); return r; }
+	static b2FloatW8 Zero() { b2FloatW8 r; r.v = _mm256_setzero_ps(); return r; }
+
+	__m256 v;
+};
+
+static inline b2FloatW8 b2MakeW8(__m256 v) { b2FloatW8 r; r.v = v; return r; }
+static inline b2FloatW8 operator+(b2FloatW8 a, b2FloatW8 b) { return b2MakeW8(_mm256_add_ps(a.v, b.v)); }
+static inline b2FloatW8 operator-(b2FloatW8 a, b2FloatW8 b) { return b2MakeW8(_mm256_sub_ps(a.v, b.v)); }
+static inline b2FloatW8 operator*(b2FloatW8 a, b2FloatW8 b) { return b2MakeW8(_mm256_mul_ps(a.v, b.v)); }
+static inline b2FloatW8 b2MinW(b2FloatW8 a, b2FloatW8 b) { return b2MakeW8(_mm256_min_ps(a.v, b.v)); }
+static inline b2FloatW8 b2MaxW(b2FloatW8 a, b2FloatW8 b) { return b2MakeW8(_mm256_max_ps(a.v, b.v)); }
+static inline b2FloatW8 b2GreaterEqualW(b2FloatW8 a, b2FloatW8 b) { return b2MakeW8(_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)); }
+static inline b2FloatW8 b2AndW(b2FloatW8 a, b2FloatW8 b) { return b2MakeW8(_mm256_and_ps(a.v, b.v)); }
+static inline void b2StoreW(float32* p, b2FloatW8 a) { _mm256_storeu_ps(p, a.v); }
+
+// Select a where the mask is set and b elsewhere.
+static inline b2FloatW8 b2SelectW(b2FloatW8 mask, b2FloatW8 a, b2FloatW8 b)
+{
+	return b2MakeW8(_mm256_blendv_ps(b.v, a.v, mask.v));
+}
+
+#include "Box2D/Dynamics/Contacts/b2WideContactKernels.h"
+
+void b2WarmStartContactBatchesAVX2(void* batches, int32 batchCount, b2Velocity* velocities)
+{
+	b2WarmStartContactBatches<b2FloatW8>(batches, batchCount, velocities);
+}
+
+void b2SolveContactBatchesAVX2(void* batches, int32 batchCount, b2Velocity* velocities)
+{
+	b2SolveContactBatches<b2FloatW8>(batches, batchCount, velocities);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
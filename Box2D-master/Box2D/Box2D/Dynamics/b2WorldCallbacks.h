@@ -45,6 +45,14 @@ public:
 	/// Called when any fixture is about to be destroyed due
 	/// to the destruction of its parent body.
 	virtual void SayGoodbye(b2Fixture* fixture) = 0;
+
+	/// Called by b2World::Clear with all the joints it is about to destroy.
+	/// By default this calls SayGoodbye for each joint.
+	virtual void SayGoodbyeToJoints(b2Joint** joints, int32 count);
+
+	/// Called by b2World::Clear with all the fixtures it is about to destroy.
+	/// By default this calls SayGoodbye for each fixture.
+	virtual void SayGoodbyeToFixtures(b2Fixture** fixtures, int32 count);
 };
 
 /// Implement this class to provide collision filtering. In other words, you can implement
@@ -386,12 +386,15 @@ static void sInterface()
 		ImGui::SliderInt("##Pos Iters", &settings.positionIterations, 0, 50);
 		ImGui::Text("Hertz");
 		ImGui::SliderFloat("##Hertz", &settings.hz, 5.0f, 120.0f, "%.0f hz");
+		ImGui::Text("Threads");
+		ImGui::SliderInt("##Threads", &settings.threadCount, 1, 8);
 		ImGui::PopItemWidth();
 
 		ImGui::Checkbox("Sleep", &settings.enableSleep);
 		ImGui::Checkbox("Warm Starting", &settings.enableWarmStarting);
 		ImGui::Checkbox("Time of Impact", &settings.enableContinuous);
 		ImGui::Checkbox("Sub-Stepping", &settings.enableSubStepping);
+		ImGui::Checkbox("Wide Solver", &settings.enableWideSolving);
 
 		ImGui::Separator();
 
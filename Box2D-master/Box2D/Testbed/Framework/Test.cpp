@@ -294,6 +294,8 @@ void Test::Step(Settings* settings)
 	m_world->SetWarmStarting(settings->enableWarmStarting);
 	m_world->SetContinuousPhysics(settings->enableContinuous);
 	m_world->SetSubStepping(settings->enableSubStepping);
+	m_world->SetWideSolving(settings->enableWideSolving);
+	m_world->SetThreadCount(settings->threadCount);
 
 	m_pointCount = 0;
 
@@ -22,11 +22,15 @@
 #include "Box2D/Box2D.h"
 #include "DebugDraw.h"
 
+// The benchmark builds the tests without graphics. It defines
+// TESTBED_HEADLESS and GLFW_INCLUDE_NONE, so only the key codes are used.
+#if !defined(TESTBED_HEADLESS)
 #if defined(__APPLE__)
 #include <OpenGL/gl3.h>
 #else
 #include "glew/glew.h"
 #endif
+#endif
 #include "glfw/glfw3.h"
 
 #include <stdlib.h>
@@ -65,6 +69,7 @@ struct Settings
 		hz = 60.0f;
 		velocityIterations = 8;
 		positionIterations = 3;
+		threadCount = 1;
 		drawShapes = true;
 		drawJoints = true;
 		drawAABBs = false;
@@ -78,6 +83,7 @@ struct Settings
 		enableWarmStarting = true;
 		enableContinuous = true;
 		enableSubStepping = false;
+		enableWideSolving = false;
 		enableSleep = true;
 		pause = false;
 		singleStep = false;
@@ -86,6 +92,7 @@ struct Settings
 	float32 hz;
 	int32 velocityIterations;
 	int32 positionIterations;
+	int32 threadCount;
 	bool drawShapes;
 	bool drawJoints;
 	bool drawAABBs;
@@ -99,6 +106,7 @@ struct Settings
 	bool enableWarmStarting;
 	bool enableContinuous;
 	bool enableSubStepping;
+	bool enableWideSolving;
 	bool enableSleep;
 	bool pause;
 	bool singleStep;
@@ -173,6 +181,9 @@ public:
 
 	void ShiftOrigin(const b2Vec2& newOrigin);
 
+	b2World* GetWorld() { return m_world; }
+	const b2World* GetWorld() const { return m_world; }
+
 protected:
 	friend class DestructionListener;
 	friend class BoundaryListener;
@@ -70,6 +70,7 @@
 #include "VaryingRestitution.h"
 #include "VerticalStack.h"
 #include "Web.h"
+#include "WorldClear.h"
 
 TestEntry g_testEntries[] =
 {
@@ -125,5 +126,6 @@ TestEntry g_testEntries[] =
 	{"Sensor Test", SensorTest::Create},
 	{"Varying Friction", VaryingFriction::Create},
 	{"Add Pair Stress Test", AddPair::Create},
+	{"World Clear", WorldClear::Create},
 	{NULL, NULL}
 };
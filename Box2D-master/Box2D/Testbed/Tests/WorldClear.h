@@ -0,0 +1,226 @@
+/*
+* Copyright (c) 2006-2009 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef WORLD_CLEAR_H
+#define WORLD_CLEAR_H
+
+class WorldClear;
+
+// Passes fixture goodbyes on to the test so it can check their order.
+class WorldClearListener : public DestructionListener
+{
+public:
+	using DestructionListener::SayGoodbye;
+	void SayGoodbye(b2Fixture* fixture) override;
+};
+
+// This tests b2World::Clear(true). The world is cleared every few seconds
+// and the boxes are dropped again, with the shelf switched between active
+// and inactive. Only the active static bodies may have broad-phase proxies
+// after a clear. Like DestroyBody, Clear must say goodbye to the joints,
+// then end the touching contacts, then say goodbye to the fixtures.
+class WorldClear : public Test
+{
+public:
+
+	enum
+	{
+		e_count = 40,
+		e_clearSteps = 180
+	};
+
+	// How far a clear has got through its callbacks.
+	enum ClearState
+	{
+		e_notClearing,
+		e_clearStarted,
+		e_jointsGone,
+		e_fixturesGone
+	};
+
+	WorldClear()
+	{
+		m_clearListener.test = this;
+		m_world->SetDestructionListener(&m_clearListener);
+		m_clearState = e_notClearing;
+		m_endedContactCount = 0;
+
+		{
+			b2BodyDef bd;
+			b2Body* ground = m_world->CreateBody(&bd);
+
+			b2EdgeShape shape;
+			shape.Set(b2Vec2(-20.0f, 0.0f), b2Vec2(20.0f, 0.0f));
+			ground->CreateFixture(&shape, 0.0f);
+		}
+
+		// An inactive static shelf that the boxes fall through until it is activated.
+		{
+			b2BodyDef bd;
+			bd.position.Set(0.0f, 6.0f);
+			bd.active = false;
+			m_shelf = m_world->CreateBody(&bd);
+
+			b2PolygonShape shape;
+			shape.SetAsBox(6.0f, 0.25f);
+			m_shelf->CreateFixture(&shape, 0.0f);
+		}
+
+		m_clearCount = 0;
+		CreateBoxes();
+	}
+
+	void CreateBoxes()
+	{
+		b2PolygonShape shape;
+		shape.SetAsBox(0.5f, 0.5f);
+
+		b2Body* bodies[2];
+		for (int32 i = 0; i < e_count; ++i)
+		{
+			b2BodyDef bd;
+			bd.type = b2_dynamicBody;
+			bd.position.Set(-5.0f + 2.5f * (i % 5), 10.0f + 1.5f * (i / 5));
+			b2Body* body = m_world->CreateBody(&bd);
+			body->CreateFixture(&shape, 1.0f);
+			if (i < 2)
+			{
+				bodies[i] = body;
+			}
+		}
+
+		// A joint for Clear to say goodbye to.
+		b2DistanceJointDef jd;
+		jd.Initialize(bodies[0], bodies[1], bodies[0]->GetPosition(), bodies[1]->GetPosition());
+		m_world->CreateJoint(&jd);
+	}
+
+	// The proxies the broad-phase should hold after a clear.
+	int32 GetStaticProxyCount() const
+	{
+		int32 count = 0;
+		for (const b2Body* b = m_world->GetBodyList(); b; b = b->GetNext())
+		{
+			if (b->GetType() != b2_staticBody || b->IsActive() == false)
+			{
+				continue;
+			}
+
+			for (const b2Fixture* f = b->GetFixtureList(); f; f = f->GetNext())
+			{
+				count += f->GetShape()->GetChildCount();
+			}
+		}
+		return count;
+	}
+
+	void Clear()
+	{
+		m_clearState = e_clearStarted;
+		m_world->Clear(true);
+		b2Assert(m_clearState == e_fixturesGone);
+		m_clearState = e_notClearing;
+		m_bomb = NULL;
+		++m_clearCount;
+
+		b2Assert(m_world->GetBodyCount() == 3);
+		b2Assert(m_world->GetContactCount() == 0);
+		b2Assert(m_world->GetProxyCount() == GetStaticProxyCount());
+
+		m_shelf->SetActive(m_clearCount % 2 == 0);
+		CreateBoxes();
+	}
+
+	void JointDestroyed(b2Joint* joint) override
+	{
+		B2_NOT_USED(joint);
+		if (m_clearState != e_notClearing)
+		{
+			b2Assert(m_clearState == e_clearStarted || m_clearState == e_jointsGone);
+			m_clearState = e_jointsGone;
+		}
+	}
+
+	void EndContact(b2Contact* contact) override
+	{
+		B2_NOT_USED(contact);
+		if (m_clearState != e_notClearing)
+		{
+			b2Assert(m_clearState == e_jointsGone);
+			++m_endedContactCount;
+		}
+	}
+
+	void FixtureDestroyed(b2Fixture* fixture)
+	{
+		B2_NOT_USED(fixture);
+		if (m_clearState != e_notClearing)
+		{
+			b2Assert(m_clearState == e_jointsGone || m_clearState == e_fixturesGone);
+			m_clearState = e_fixturesGone;
+		}
+	}
+
+	void Keyboard(int key)
+	{
+		switch (key)
+		{
+		case GLFW_KEY_C:
+			Clear();
+			break;
+
+		case GLFW_KEY_A:
+			m_shelf->SetActive(!m_shelf->IsActive());
+			break;
+		}
+	}
+
+	void Step(Settings* settings)
+	{
+		if (settings->pause == false && m_stepCount > 0 && m_stepCount % e_clearSteps == 0)
+		{
+			Clear();
+		}
+
+		Test::Step(settings);
+
+		g_debugDraw.DrawString(5, m_textLine, "Keys: (c) clear, (a) activate shelf");
+		m_textLine += DRAW_STRING_NEW_LINE;
+		g_debugDraw.DrawString(5, m_textLine, "shelf %s, cleared %d times, contacts ended by clears = %d, proxies = %d",
+			m_shelf->IsActive() ? "active" : "inactive", m_clearCount, m_endedContactCount, m_world->GetProxyCount());
+		m_textLine += DRAW_STRING_NEW_LINE;
+	}
+
+	static Test* Create()
+	{
+		return new WorldClear;
+	}
+
+	WorldClearListener m_clearListener;
+	ClearState m_clearState;
+	b2Body* m_shelf;
+	int32 m_clearCount;
+	int32 m_endedContactCount;
+};
+
+inline void WorldClearListener::SayGoodbye(b2Fixture* fixture)
+{
+	((WorldClear*)test)->FixtureDestroyed(fixture);
+}
+
+#endif
@@ -121,6 +121,27 @@ project "HelloWorld"
 	files { "HelloWorld/HelloWorld.cpp" }
 	includedirs { "." }
 	links { "Box2D" }
+	configuration { "gmake" }
+		links { "pthread" }
+
+project "Benchmark"
+	kind "ConsoleApp"
+	language "C++"
+	defines { "TESTBED_HEADLESS", "GLFW_INCLUDE_NONE" }
+	files { "Benchmark/Benchmark.cpp", "Testbed/Framework/Test.h", "Testbed/Framework/Test.cpp", "Testbed/Tests/*.h", "Testbed/Tests/TestEntries.cpp" }
+	includedirs { "." }
+	links { "Box2D" }
+	configuration { "gmake" }
+		links { "pthread" }
+
+project "MicroBenchmark"
+	kind "ConsoleApp"
+	language "C++"
+	files { "Benchmark/MicroBenchmark.cpp" }
+	includedirs { "." }
+	links { "Box2D" }
+	configuration { "gmake" }
+		links { "pthread" }
 
 project "Testbed"
 	kind "ConsoleApp"
@@ -24,6 +24,9 @@
 #include "Box2D/Collision/b2DynamicTree.h"
 #include <algorithm>
 
+class b2TaskScheduler;
+struct b2PairBuffer;
+
 struct b2Pair
 {
 	int32 proxyIdA;
@@ -52,6 +55,14 @@ public:
 	/// Destroy a proxy. It is up to the client to remove any pairs.
 	void DestroyProxy(int32 proxyId);
 
+	/// Destroy all proxies at once, along with any buffered moves.
+	void Clear();
+
+	/// Proxies created between these calls go into the tree all at once when
+	/// EndBulkInsert builds it. See b2DynamicTree::BeginBulkInsert.
+	void BeginBulkInsert();
+	void EndBulkInsert();
+
 	/// Call MoveProxy as many times as you like, then when you are done
 	/// call UpdatePairs to finalized the proxy pairs (for your time step).
 	void MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement);
@@ -72,8 +83,10 @@ public:
 	int32 GetProxyCount() const;
 
 	/// Update the pairs. This results in pair callbacks. This can only add pairs.
+	/// If a task scheduler is given, the tree queries run on it. The callback
+	/// is still called on this thread, in the same order.
 	template <typename T>
-	void UpdatePairs(T* callback);
+	void UpdatePairs(T* callback, b2TaskScheduler* scheduler = nullptr);
 
 	/// Query an AABB for overlapping proxies. The callback class
 	/// is called for each proxy that overlaps the supplied AABB.
@@ -113,6 +126,10 @@ private:
 
 	bool QueryCallback(int32 proxyId);
 
+	// Fill the pair buffer sorted, querying the tree on the scheduler.
+	void FindPairs(b2TaskScheduler* scheduler);
+	static void FindPairsTask(int32 begin, int32 end, int32 threadIndex, void* context);
+
 	b2DynamicTree m_tree;
 
 	int32 m_proxyCount;
@@ -126,6 +143,12 @@ private:
 	int32 m_pairCount;
 
 	int32 m_queryProxyId;
+
+	// Per-thread pair buffers and sort scratch for FindPairs.
+	b2PairBuffer* m_threadPairs;
+	int32 m_threadPairCount;
+	b2Pair* m_sortBuffer;
+	int32 m_sortCapacity;
 };
 
 /// This is used to sort pairs.
@@ -182,34 +205,42 @@ inline float32 b2BroadPhase::GetTreeQuality() const
 }
 
 template <typename T>
-void b2BroadPhase::UpdatePairs(T* callback)
+void b2BroadPhase::UpdatePairs(T* callback, b2TaskScheduler* scheduler)
 {
-	// Reset pair buffer
-	m_pairCount = 0;
-
-	// Perform tree queries for all moving proxies.
-	for (int32 i = 0; i < m_moveCount; ++i)
+	if (scheduler && m_moveCount > 0)
 	{
-		m_queryProxyId = m_moveBuffer[i];
-		if (m_queryProxyId == e_nullProxy)
+		// Fills and sorts the pair buffer.
+		FindPairs(scheduler);
+	}
+	else
+	{
+		// Reset pair buffer
+		m_pairCount = 0;
+
+		// Perform tree queries for all moving proxies.
+		for (int32 i = 0; i < m_moveCount; ++i)
 		{
-			continue;
-		}
+			m_queryProxyId = m_moveBuffer[i];
+			if (m_queryProxyId == e_nullProxy)
+			{
+				continue;
+			}
+
+			// We have to query the tree with the fat AABB so that
+			// we don't fail to create a pair that may touch later.
+			const b2AABB& fatAABB = m_tree.GetFatAABB(m_queryProxyId);
 
-		// We have to query the tree with the fat AABB so that
-		// we don't fail to create a pair that may touch later.
-		const b2AABB& fatAABB = m_tree.GetFatAABB(m_queryProxyId);
+			// Query tree, create pairs and add them pair buffer.
+			m_tree.Query(this, fatAABB);
+		}
 
-		// Query tree, create pairs and add them pair buffer.
-		m_tree.Query(this, fatAABB);
+		// Sort the pair buffer to expose duplicates.
+		std::sort(m_pairBuffer, m_pairBuffer + m_pairCount, b2PairLessThan);
 	}
 
 	// Reset move buffer
 	m_moveCount = 0;
 
-	// Sort the pair buffer to expose duplicates.
-	std::sort(m_pairBuffer, m_pairBuffer + m_pairCount, b2PairLessThan);
-
 	// Send the pairs back to the client.
 	int32 i = 0;
 	while (i < m_pairCount)
@@ -254,4 +285,14 @@ inline void b2BroadPhase::ShiftOrigin(const b2Vec2& newOrigin)
 	m_tree.ShiftOrigin(newOrigin);
 }
 
+inline void b2BroadPhase::BeginBulkInsert()
+{
+	m_tree.BeginBulkInsert();
+}
+
+inline void b2BroadPhase::EndBulkInsert()
+{
+	m_tree.EndBulkInsert();
+}
+
 #endif
@@ -41,6 +41,8 @@ b2DynamicTree::b2DynamicTree()
 	m_path = 0;
 
 	m_insertionCount = 0;
+
+	m_bulkInsert = false;
 }
 
 b2DynamicTree::~b2DynamicTree()
@@ -49,6 +51,26 @@ b2DynamicTree::~b2DynamicTree()
 	b2Free(m_nodes);
 }
 
+void b2DynamicTree::Clear()
+{
+	m_root = b2_nullNode;
+	m_nodeCount = 0;
+
+	// Put every node back on the free list.
+	for (int32 i = 0; i < m_nodeCapacity - 1; ++i)
+	{
+		m_nodes[i].next = i + 1;
+		m_nodes[i].height = -1;
+	}
+	m_nodes[m_nodeCapacity-1].next = b2_nullNode;
+	m_nodes[m_nodeCapacity-1].height = -1;
+	m_freeList = 0;
+
+	m_path = 0;
+
+	m_insertionCount = 0;
+}
+
 // Allocate a node from the pool. Grow the pool if necessary.
 int32 b2DynamicTree::AllocateNode()
 {
@@ -113,7 +135,10 @@ int32 b2DynamicTree::CreateProxy(const b2AABB& aabb, void* userData)
 	m_nodes[proxyId].userData = userData;
 	m_nodes[proxyId].height = 0;
 
-	InsertLeaf(proxyId);
+	if (m_bulkInsert == false)
+	{
+		InsertLeaf(proxyId);
+	}
 
 	return proxyId;
 }
@@ -122,6 +147,7 @@ void b2DynamicTree::DestroyProxy(int32 proxyId)
 {
 	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
 	b2Assert(m_nodes[proxyId].IsLeaf());
+	b2Assert(m_bulkInsert == false);
 
 	RemoveLeaf(proxyId);
 	FreeNode(proxyId);
@@ -132,6 +158,7 @@ bool b2DynamicTree::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& d
 	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
 
 	b2Assert(m_nodes[proxyId].IsLeaf());
+	b2Assert(m_bulkInsert == false);
 
 	if (m_nodes[proxyId].aabb.Contains(aabb))
 	{
@@ -769,6 +796,147 @@ void b2DynamicTree::RebuildBottomUp()
 	Validate();
 }
 
+void b2DynamicTree::BeginBulkInsert()
+{
+	m_bulkInsert = true;
+}
+
+// Spread the low 16 bits of x to the even bits.
+static inline uint32 b2SpreadBits(uint32 x)
+{
+	x &= 0x0000FFFF;
+	x = (x | (x << 8)) & 0x00FF00FF;
+	x = (x | (x << 4)) & 0x0F0F0F0F;
+	x = (x | (x << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;
+	return x;
+}
+
+// Least significant digit radix sort of the leaves by code.
+static void b2SortLeaves(b2TreeLeaf* leaves, b2TreeLeaf* scratch, int32 count)
+{
+	b2TreeLeaf* source = leaves;
+	b2TreeLeaf* target = scratch;
+
+	for (int32 shift = 0; shift < 32; shift += 8)
+	{
+		int32 offsets[256] = {0};
+		for (int32 i = 0; i < count; ++i)
+		{
+			++offsets[(source[i].code >> shift) & 0xFF];
+		}
+
+		int32 sum = 0;
+		for (int32 i = 0; i < 256; ++i)
+		{
+			int32 n = offsets[i];
+			offsets[i] = sum;
+			sum += n;
+		}
+
+		for (int32 i = 0; i < count; ++i)
+		{
+			target[offsets[(source[i].code >> shift) & 0xFF]++] = source[i];
+		}
+
+		b2Swap(source, target);
+	}
+
+	// An even number of passes leaves the result in leaves.
+	b2Assert(source == leaves);
+}
+
+void b2DynamicTree::EndBulkInsert()
+{
+	m_bulkInsert = false;
+
+	b2TreeLeaf* leaves = (b2TreeLeaf*)b2Alloc(2 * m_nodeCount * sizeof(b2TreeLeaf));
+	int32 count = 0;
+	b2Vec2 lower(b2_maxFloat, b2_maxFloat);
+	b2Vec2 upper(-b2_maxFloat, -b2_maxFloat);
+
+	// Build array of leaves, old and new. Free the rest.
+	for (int32 i = 0; i < m_nodeCapacity; ++i)
+	{
+		if (m_nodes[i].height < 0)
+		{
+			// free node in pool
+			continue;
+		}
+
+		if (m_nodes[i].IsLeaf())
+		{
+			m_nodes[i].parent = b2_nullNode;
+			leaves[count].index = i;
+			++count;
+
+			b2Vec2 center = m_nodes[i].aabb.GetCenter();
+			lower = b2Min(lower, center);
+			upper = b2Max(upper, center);
+		}
+		else
+		{
+			FreeNode(i);
+		}
+	}
+
+	if (count == 0)
+	{
+		m_root = b2_nullNode;
+		b2Free(leaves);
+		return;
+	}
+
+	// Order the leaves along a Morton curve through the centers' bounds, so that
+	// leaves close in the order are close in space.
+	b2Vec2 extent = upper - lower;
+	float32 scaleX = extent.x > 0.0f ? 65535.0f / extent.x : 0.0f;
+	float32 scaleY = extent.y > 0.0f ? 65535.0f / extent.y : 0.0f;
+	for (int32 i = 0; i < count; ++i)
+	{
+		b2Vec2 center = m_nodes[leaves[i].index].aabb.GetCenter();
+		uint32 x = (uint32)(scaleX * (center.x - lower.x));
+		uint32 y = (uint32)(scaleY * (center.y - lower.y));
+		leaves[i].code = b2SpreadBits(x) | (b2SpreadBits(y) << 1);
+	}
+
+	b2SortLeaves(leaves, leaves + count, count);
+
+	m_root = BuildTopDown(leaves, count);
+	b2Free(leaves);
+
+	Validate();
+}
+
+// Build a subtree over leaves that are sorted along the Morton curve by splitting
+// them in half. The result is balanced. Returns the subtree root.
+int32 b2DynamicTree::BuildTopDown(b2TreeLeaf* leaves, int32 count)
+{
+	if (count == 1)
+	{
+		return leaves[0].index;
+	}
+
+	int32 half = count / 2;
+	int32 index1 = BuildTopDown(leaves, half);
+	int32 index2 = BuildTopDown(leaves + half, count - half);
+
+	int32 parentIndex = AllocateNode();
+	b2TreeNode* parent = m_nodes + parentIndex;
+	b2TreeNode* child1 = m_nodes + index1;
+	b2TreeNode* child2 = m_nodes + index2;
+	parent->child1 = index1;
+	parent->child2 = index2;
+	parent->height = 1 + b2Max(child1->height, child2->height);
+	parent->aabb.Combine(child1->aabb, child2->aabb);
+	parent->parent = b2_nullNode;
+
+	child1->parent = parentIndex;
+	child2->parent = parentIndex;
+
+	return parentIndex;
+}
+
 void b2DynamicTree::ShiftOrigin(const b2Vec2& newOrigin)
 {
 	// Build array of leaves. Free the rest.
@@ -50,6 +50,13 @@ struct b2TreeNode
 	int32 height;
 };
 
+/// A leaf and the Morton code of its AABB center, for building the tree in bulk.
+struct b2TreeLeaf
+{
+	uint32 code;
+	int32 index;
+};
+
 /// A dynamic AABB tree broad-phase, inspired by Nathanael Presson's btDbvt.
 /// A dynamic tree arranges data in a binary tree to accelerate
 /// queries such as volume queries and ray casts. Leafs are proxies
@@ -73,6 +80,17 @@ public:
 	/// Destroy a proxy. This asserts if the id is invalid.
 	void DestroyProxy(int32 proxyId);
 
+	/// Destroy all proxies at once. The node pool keeps its capacity.
+	void Clear();
+
+	/// Create the following proxies without inserting them into the tree. Until
+	/// EndBulkInsert they are not found by queries and must not be moved or destroyed.
+	void BeginBulkInsert();
+
+	/// Build the tree over all proxies at once, in O(n). This is much faster than
+	/// inserting many proxies one at a time.
+	void EndBulkInsert();
+
 	/// Move a proxy with a swepted AABB. If the proxy has moved outside of its fattened AABB,
 	/// then the proxy is removed from the tree and re-inserted. Otherwise
 	/// the function returns immediately.
@@ -133,6 +151,8 @@ private:
 
 	int32 Balance(int32 index);
 
+	int32 BuildTopDown(b2TreeLeaf* leaves, int32 count);
+
 	int32 ComputeHeight() const;
 	int32 ComputeHeight(int32 nodeId) const;
 
@@ -151,6 +171,8 @@ private:
 	uint32 m_path;
 
 	int32 m_insertionCount;
+
+	bool m_bulkInsert;
 };
 
 inline void* b2DynamicTree::GetUserData(int32 proxyId) const
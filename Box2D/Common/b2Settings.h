@@ -137,6 +137,14 @@ void* b2Alloc(int32 size);
 /// If you implement b2Alloc, you should also implement this function.
 void b2Free(void* mem);
 
+typedef void* b2AllocFcn(int32 size);
+typedef void b2FreeFcn(void* mem);
+
+/// Route b2Alloc and b2Free through your own functions at run time, for example
+/// to count allocations. Pass nullptr to restore malloc and free. Only call this
+/// while no Box2D objects exist.
+void b2SetAllocator(b2AllocFcn* allocFcn, b2FreeFcn* freeFcn);
+
 /// Logging function.
 void b2Log(const char* string, ...);
 
@@ -0,0 +1,56 @@
+/*
+* Copyright (c) 2006-2011 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef B2_TASK_SCHEDULER_H
+#define B2_TASK_SCHEDULER_H
+
+#include "Box2D/Common/b2Settings.h"
+
+/// Process the items [begin, end) of a parallel-for. The thread index is in
+/// [0, thread count) and identifies the calling thread for the duration of
+/// the call, so it can be used to pick per-thread scratch memory.
+typedef void b2TaskFcn(int32 begin, int32 end, int32 threadIndex, void* context);
+
+/// Identifies an enqueued parallel-for until it is waited on.
+typedef void* b2TaskHandle;
+
+/// Interface to a job system. The multithreaded stages of b2World::Step
+/// are built on this, so implement it to run them on your engine's own
+/// workers, or use b2WorkStealingScheduler. Box2D calls ParallelFor and
+/// Wait from the thread that calls b2World::Step; that thread must run
+/// tasks with thread index 0.
+class b2TaskScheduler
+{
+public:
+	virtual ~b2TaskScheduler() {}
+
+	/// Get the number of threads that may run tasks, including the caller.
+	virtual int32 GetThreadCount() const = 0;
+
+	/// Enqueue a parallel-for over [0, count). The range may be split into
+	/// sub-ranges of at least minRange items (except the last), which may
+	/// run in any order on any thread.
+	/// @return a handle that must be passed to Wait exactly once.
+	virtual b2TaskHandle ParallelFor(int32 count, int32 minRange, b2TaskFcn* fcn, void* context) = 0;
+
+	/// Block until every item of the parallel-for has been processed.
+	virtual void Wait(b2TaskHandle handle) = 0;
+};
+
+#endif
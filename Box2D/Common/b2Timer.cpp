@@ -83,7 +83,7 @@ float32 b2Timer::GetMilliseconds() const
 {
     timeval t;
     gettimeofday(&t, 0);
-    return 1000.0f * (t.tv_sec - m_start_sec) + 0.001f * (t.tv_usec - m_start_usec);
+    return 1000.0f * float32(t.tv_sec - long(m_start_sec)) + 0.001f * float32(t.tv_usec - long(m_start_usec));
 }
 
 #else
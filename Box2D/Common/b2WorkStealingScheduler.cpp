@@ -0,0 +1,347 @@
+/*
+* Copyright (c) 2006-2011 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "Box2D/Common/b2WorkStealingScheduler.h"
+#include "Box2D/Common/b2Math.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+// A range of items is packed as begin | (end << 32) so that it can be
+// shrunk from either end with a single compare-and-swap.
+static inline uint64_t b2PackRange(int32 begin, int32 end)
+{
+	return uint64_t(uint32(begin)) | (uint64_t(uint32(end)) << 32);
+}
+
+static inline int32 b2RangeBegin(uint64_t range)
+{
+	return int32(uint32(range));
+}
+
+static inline int32 b2RangeEnd(uint64_t range)
+{
+	return int32(uint32(range >> 32));
+}
+
+struct b2Task
+{
+	b2TaskFcn* fcn;
+	void* context;
+	int32 count;
+	int32 minRange;
+
+	// Remaining items of each thread.
+	std::atomic<uint64_t>* ranges;
+	std::atomic<int32> completed;
+
+	// Workers register before looking at a task so that Wait can tell when
+	// the slot is safe to reuse.
+	std::atomic<bool> active;
+	std::atomic<int32> users;
+
+	// Protected by the scheduler mutex.
+	bool used;
+};
+
+struct b2SchedulerState
+{
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake;
+
+	// Bumped for every new task so that a worker that found nothing to do
+	// does not go to sleep right after a task was added.
+	uint32 generation;
+	bool quit;
+
+	b2Task tasks[b2_maxTasks];
+};
+
+b2WorkStealingScheduler::b2WorkStealingScheduler(int32 threadCount)
+{
+	b2Assert(threadCount >= 1);
+	m_threadCount = threadCount;
+
+	void* mem = b2Alloc(sizeof(b2SchedulerState));
+	m_state = new (mem) b2SchedulerState;
+	m_state->generation = 0;
+	m_state->quit = false;
+
+	for (int32 i = 0; i < b2_maxTasks; ++i)
+	{
+		b2Task* task = m_state->tasks + i;
+		task->ranges = (std::atomic<uint64_t>*)b2Alloc(m_threadCount * sizeof(std::atomic<uint64_t>));
+		for (int32 j = 0; j < m_threadCount; ++j)
+		{
+			new (task->ranges + j) std::atomic<uint64_t>(0);
+		}
+		task->completed = 0;
+		task->active = false;
+		task->users = 0;
+		task->used = false;
+	}
+
+	for (int32 i = 1; i < m_threadCount; ++i)
+	{
+		m_state->threads.push_back(std::thread(&b2WorkStealingScheduler::WorkerMain, this, i));
+	}
+}
+
+b2WorkStealingScheduler::~b2WorkStealingScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_state->mutex);
+		m_state->quit = true;
+	}
+	m_state->wake.notify_all();
+
+	for (size_t i = 0; i < m_state->threads.size(); ++i)
+	{
+		m_state->threads[i].join();
+	}
+
+	for (int32 i = 0; i < b2_maxTasks; ++i)
+	{
+		b2Assert(m_state->tasks[i].used == false);
+		b2Free(m_state->tasks[i].ranges);
+	}
+
+	m_state->~b2SchedulerState();
+	b2Free(m_state);
+}
+
+b2TaskHandle b2WorkStealingScheduler::ParallelFor(int32 count, int32 minRange, b2TaskFcn* fcn, void* context)
+{
+	b2Task* task = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(m_state->mutex);
+		for (int32 i = 0; i < b2_maxTasks; ++i)
+		{
+			if (m_state->tasks[i].used == false)
+			{
+				task = m_state->tasks + i;
+				task->used = true;
+				break;
+			}
+		}
+	}
+
+	// Too many outstanding tasks.
+	b2Assert(task != nullptr);
+	if (task == nullptr)
+	{
+		return nullptr;
+	}
+
+	task->fcn = fcn;
+	task->context = context;
+	task->count = b2Max(count, 0);
+	task->minRange = b2Max(minRange, 1);
+	task->completed = 0;
+
+	// Give every thread an equal share up front.
+	int32 share = task->count / m_threadCount;
+	int32 extra = task->count % m_threadCount;
+	int32 begin = 0;
+	for (int32 i = 0; i < m_threadCount; ++i)
+	{
+		int32 end = begin + share + (i < extra ? 1 : 0);
+		task->ranges[i] = b2PackRange(begin, end);
+		begin = end;
+	}
+
+	task->active = true;
+
+	if (m_threadCount > 1)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_state->mutex);
+			++m_state->generation;
+		}
+		m_state->wake.notify_all();
+	}
+
+	return task;
+}
+
+void b2WorkStealingScheduler::Wait(b2TaskHandle handle)
+{
+	b2Task* task = (b2Task*)handle;
+	if (task == nullptr)
+	{
+		return;
+	}
+
+	// Help until there is nothing left to take, then wait for the chunks
+	// still running on other threads.
+	while (RunChunk(task, 0))
+	{
+	}
+
+	while (task->completed.load() < task->count)
+	{
+		std::this_thread::yield();
+	}
+
+	task->active = false;
+	while (task->users.load() > 0)
+	{
+		std::this_thread::yield();
+	}
+
+	std::lock_guard<std::mutex> lock(m_state->mutex);
+	task->used = false;
+}
+
+void b2WorkStealingScheduler::WorkerMain(int32 threadIndex)
+{
+	for (;;)
+	{
+		uint32 generation;
+		{
+			std::lock_guard<std::mutex> lock(m_state->mutex);
+			if (m_state->quit)
+			{
+				return;
+			}
+			generation = m_state->generation;
+		}
+
+		b2Task* task = FindTask();
+		if (task)
+		{
+			while (RunChunk(task, threadIndex))
+			{
+			}
+			--task->users;
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_state->mutex);
+		while (m_state->quit == false && m_state->generation == generation)
+		{
+			m_state->wake.wait(lock);
+		}
+	}
+}
+
+// Returns an active task with work left, registered as used by the caller.
+b2Task* b2WorkStealingScheduler::FindTask()
+{
+	for (int32 i = 0; i < b2_maxTasks; ++i)
+	{
+		b2Task* task = m_state->tasks + i;
+		++task->users;
+		if (task->active)
+		{
+			for (int32 j = 0; j < m_threadCount; ++j)
+			{
+				uint64_t range = task->ranges[j].load();
+				if (b2RangeBegin(range) < b2RangeEnd(range))
+				{
+					return task;
+				}
+			}
+		}
+		--task->users;
+	}
+	return nullptr;
+}
+
+// Runs one chunk of the thread's own range, or refills the own range by
+// stealing. Returns false when no work is left to take.
+bool b2WorkStealingScheduler::RunChunk(b2Task* task, int32 threadIndex)
+{
+	std::atomic<uint64_t>* own = task->ranges + threadIndex;
+	uint64_t range = own->load();
+	while (b2RangeBegin(range) < b2RangeEnd(range))
+	{
+		int32 begin = b2RangeBegin(range);
+		int32 end = b2RangeEnd(range);
+		int32 split = b2Min(begin + task->minRange, end);
+		if (own->compare_exchange_weak(range, b2PackRange(split, end)))
+		{
+			task->fcn(begin, split, threadIndex, task->context);
+			task->completed += split - begin;
+			return true;
+		}
+	}
+
+	for (;;)
+	{
+		// Pick the victim with the most work left.
+		int32 victim = -1;
+		int32 victimCount = 0;
+		for (int32 i = 0; i < m_threadCount; ++i)
+		{
+			if (i == threadIndex)
+			{
+				continue;
+			}
+
+			range = task->ranges[i].load();
+			int32 remaining = b2RangeEnd(range) - b2RangeBegin(range);
+			if (remaining > victimCount)
+			{
+				victim = i;
+				victimCount = remaining;
+			}
+		}
+
+		if (victim == -1)
+		{
+			return false;
+		}
+
+		std::atomic<uint64_t>* other = task->ranges + victim;
+		range = other->load();
+		int32 begin = b2RangeBegin(range);
+		int32 end = b2RangeEnd(range);
+		if (begin >= end)
+		{
+			continue;
+		}
+
+		if (end - begin <= task->minRange)
+		{
+			// Too small to split, take it all.
+			if (other->compare_exchange_strong(range, b2PackRange(end, end)))
+			{
+				task->fcn(begin, end, threadIndex, task->context);
+				task->completed += end - begin;
+				return true;
+			}
+		}
+		else
+		{
+			// Take the back half; the victim keeps working on the front.
+			int32 mid = begin + (end - begin) / 2;
+			if (other->compare_exchange_strong(range, b2PackRange(begin, mid)))
+			{
+				own->store(b2PackRange(mid, end));
+				return true;
+			}
+		}
+	}
+}
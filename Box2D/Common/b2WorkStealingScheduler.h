@@ -0,0 +1,58 @@
+/*
+* Copyright (c) 2006-2011 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef B2_WORK_STEALING_SCHEDULER_H
+#define B2_WORK_STEALING_SCHEDULER_H
+
+#include "Box2D/Common/b2TaskScheduler.h"
+
+const int32 b2_maxTasks = 16;
+
+struct b2SchedulerState;
+struct b2Task;
+
+/// The default task scheduler. It owns a fixed set of worker threads. A
+/// parallel-for is split into one contiguous range per thread; a thread
+/// takes chunks from the front of its own range and, once that is empty,
+/// steals the back half of the largest remaining range. The thread that
+/// calls Wait helps as thread 0.
+class b2WorkStealingScheduler : public b2TaskScheduler
+{
+public:
+	/// @param threadCount the total number of threads, including the caller.
+	b2WorkStealingScheduler(int32 threadCount);
+	~b2WorkStealingScheduler();
+
+	int32 GetThreadCount() const override { return m_threadCount; }
+
+	b2TaskHandle ParallelFor(int32 count, int32 minRange, b2TaskFcn* fcn, void* context) override;
+
+	void Wait(b2TaskHandle handle) override;
+
+private:
+
+	void WorkerMain(int32 threadIndex);
+	bool RunChunk(b2Task* task, int32 threadIndex);
+	b2Task* FindTask();
+
+	b2SchedulerState* m_state;
+	int32 m_threadCount;
+};
+
+#endif
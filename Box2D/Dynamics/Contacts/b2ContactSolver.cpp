@@ -19,6 +19,7 @@
 #include "Box2D/Dynamics/Contacts/b2ContactSolver.h"
 
 #include "Box2D/Dynamics/Contacts/b2Contact.h"
+#include "Box2D/Dynamics/Contacts/b2WideContactSolver.h"
 #include "Box2D/Dynamics/b2Body.h"
 #include "Box2D/Dynamics/b2Fixture.h"
 #include "Box2D/Dynamics/b2World.h"
@@ -54,6 +55,7 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 	m_positions = def->positions;
 	m_velocities = def->velocities;
 	m_contacts = def->contacts;
+	m_wideSolver = nullptr;
 
 	// Initialize position independent portions of the constraints.
 	for (int32 i = 0; i < m_count; ++i)
@@ -133,6 +135,12 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 
 b2ContactSolver::~b2ContactSolver()
 {
+	if (m_wideSolver)
+	{
+		m_wideSolver->~b2WideContactSolver();
+		m_allocator->Free(m_wideSolver);
+	}
+
 	m_allocator->Free(m_velocityConstraints);
 	m_allocator->Free(m_positionConstraints);
 }
@@ -247,10 +255,24 @@ void b2ContactSolver::InitializeVelocityConstraints()
 			}
 		}
 	}
+
+	// The wide solver only implements block solving.
+	const b2WideContactKernels* kernels = b2WideContactSolver::GetKernels();
+	if (m_step.wideSolving && g_blockSolve && kernels && m_count > 0)
+	{
+		void* mem = m_allocator->Allocate(sizeof(b2WideContactSolver));
+		m_wideSolver = new (mem) b2WideContactSolver(kernels, m_velocityConstraints, m_count, m_velocities, m_allocator);
+	}
 }
 
 void b2ContactSolver::WarmStart()
 {
+	if (m_wideSolver)
+	{
+		m_wideSolver->WarmStart();
+		return;
+	}
+
 	// Warm start.
 	for (int32 i = 0; i < m_count; ++i)
 	{
@@ -291,6 +313,12 @@ void b2ContactSolver::WarmStart()
 
 void b2ContactSolver::SolveVelocityConstraints()
 {
+	if (m_wideSolver)
+	{
+		m_wideSolver->SolveVelocityConstraints();
+		return;
+	}
+
 	for (int32 i = 0; i < m_count; ++i)
 	{
 		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
@@ -603,6 +631,11 @@ void b2ContactSolver::SolveVelocityConstraints()
 
 void b2ContactSolver::StoreImpulses()
 {
+	if (m_wideSolver)
+	{
+		m_wideSolver->StoreImpulses();
+	}
+
 	for (int32 i = 0; i < m_count; ++i)
 	{
 		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
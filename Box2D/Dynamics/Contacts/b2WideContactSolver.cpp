@@ -0,0 +1,257 @@
+/*
+* Copyright (c) 2006-2011 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "Box2D/Dynamics/Contacts/b2WideContactSolver.h"
+#include "Box2D/Dynamics/Contacts/b2ContactSolver.h"
+#include "Box2D/Common/b2StackAllocator.h"
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define B2_WIDE_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// Constraints that do not fit in one of these colors are solved one per batch.
+const int32 b2_wideColorCount = 12;
+
+#ifdef B2_WIDE_SSE2
+
+struct b2FloatW4
+{
+	enum { width = 4 };
+
+	static b2FloatW4 Load(const float32* p) { b2FloatW4 r; r.v = _mm_loadu_ps(p); return r; }
+	static b2FloatW4 Splat(float32 x) { b2FloatW4 r; r.v = _mm_set1_ps(x); return r; }
+	static b2FloatW4 Zero() { b2FloatW4 r; r.v = _mm_setzero_ps(); return r; }
+
+	__m128 v;
+};
+
+static inline b2FloatW4 b2MakeW4(__m128 v) { b2FloatW4 r; r.v = v; return r; }
+static inline b2FloatW4 operator+(b2FloatW4 a, b2FloatW4 b) { return b2MakeW4(_mm_add_ps(a.v, b.v)); }
+static inline b2FloatW4 operator-(b2FloatW4 a, b2FloatW4 b) { return b2MakeW4(_mm_sub_ps(a.v, b.v)); }
+static inline b2FloatW4 operator*(b2FloatW4 a, b2FloatW4 b) { return b2MakeW4(_mm_mul_ps(a.v, b.v)); }
+static inline b2FloatW4 b2MinW(b2FloatW4 a, b2FloatW4 b) { return b2MakeW4(_mm_min_ps(a.v, b.v)); }
+static inline b2FloatW4 b2MaxW(b2FloatW4 a, b2FloatW4 b) { return b2MakeW4(_mm_max_ps(a.v, b.v)); }
+static inline b2FloatW4 b2GreaterEqualW(b2FloatW4 a, b2FloatW4 b) { return b2MakeW4(_mm_cmpge_ps(a.v, b.v)); }
+static inline b2FloatW4 b2AndW(b2FloatW4 a, b2FloatW4 b) { return b2MakeW4(_mm_and_ps(a.v, b.v)); }
+static inline void b2StoreW(float32* p, b2FloatW4 a) { _mm_storeu_ps(p, a.v); }
+
+// Select a where the mask is set and b elsewhere.
+static inline b2FloatW4 b2SelectW(b2FloatW4 mask, b2FloatW4 a, b2FloatW4 b)
+{
+	return b2MakeW4(_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)));
+}
+
+#include "Box2D/Dynamics/Contacts/b2WideContactKernels.h"
+
+// Defined in b2WideContactSolverAVX2.cpp
+void b2WarmStartContactBatchesAVX2(void* batches, int32 batchCount, b2Velocity* velocities);
+void b2SolveContactBatchesAVX2(void* batches, int32 batchCount, b2Velocity* velocities);
+
+static const b2WideContactKernels b2_sse2Kernels =
+{
+	4,
+	sizeof(b2ContactBatch<4>),
+	b2PackContactBatches<4>,
+	b2StoreContactBatches<4>,
+	b2WarmStartContactBatches<b2FloatW4>,
+	b2SolveContactBatches<b2FloatW4>
+};
+
+static const b2WideContactKernels b2_avx2Kernels =
+{
+	8,
+	sizeof(b2ContactBatch<8>),
+	b2PackContactBatches<8>,
+	b2StoreContactBatches<8>,
+	b2WarmStartContactBatchesAVX2,
+	b2SolveContactBatchesAVX2
+};
+
+static bool b2HasAVX2()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+	{
+		return false;
+	}
+
+	// The OS must save the AVX registers.
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (osxsave == false || avx == false || (_xgetbv(0) & 6) != 6)
+	{
+		return false;
+	}
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+const b2WideContactKernels* b2WideContactSolver::GetKernels()
+{
+	static const b2WideContactKernels* kernels = b2HasAVX2() ? &b2_avx2Kernels : &b2_sse2Kernels;
+	return kernels;
+}
+
+#else
+
+const b2WideContactKernels* b2WideContactSolver::GetKernels()
+{
+	return nullptr;
+}
+
+#endif
+
+b2WideContactSolver::b2WideContactSolver(const b2WideContactKernels* kernels, b2ContactVelocityConstraint* constraints, int32 count,
+										 b2Velocity* velocities, b2StackAllocator* allocator)
+{
+	m_kernels = kernels;
+	m_constraints = constraints;
+	m_velocities = velocities;
+	m_allocator = allocator;
+
+	const int32 width = kernels->width;
+
+	// Only dynamic bodies constrain the coloring. Static and kinematic bodies
+	// are not changed by the solver, so any number of lanes can share them.
+	int32 bodyCount = 0;
+	for (int32 i = 0; i < count; ++i)
+	{
+		const b2ContactVelocityConstraint* vc = constraints + i;
+		if (vc->invMassA > 0.0f || vc->invIA > 0.0f)
+		{
+			bodyCount = b2Max(bodyCount, vc->indexA + 1);
+		}
+		if (vc->invMassB > 0.0f || vc->invIB > 0.0f)
+		{
+			bodyCount = b2Max(bodyCount, vc->indexB + 1);
+		}
+	}
+
+	m_colors = (int32*)m_allocator->Allocate(count * sizeof(int32));
+	int32 wordCount = (bodyCount + 31) / 32;
+	uint32* bodySets = (uint32*)m_allocator->Allocate(b2_wideColorCount * wordCount * sizeof(uint32));
+	memset(bodySets, 0, b2_wideColorCount * wordCount * sizeof(uint32));
+
+	// Greedy coloring. The last color holds the overflow.
+	int32 colorCounts[b2_wideColorCount + 1] = {0};
+	for (int32 i = 0; i < count; ++i)
+	{
+		const b2ContactVelocityConstraint* vc = constraints + i;
+		bool dynamicA = vc->invMassA > 0.0f || vc->invIA > 0.0f;
+		bool dynamicB = vc->invMassB > 0.0f || vc->invIB > 0.0f;
+		uint32 bitA = 1u << (vc->indexA & 31);
+		uint32 bitB = 1u << (vc->indexB & 31);
+
+		int32 color = b2_wideColorCount;
+		for (int32 j = 0; j < b2_wideColorCount; ++j)
+		{
+			uint32* bodySet = bodySets + j * wordCount;
+			if (dynamicA && (bodySet[vc->indexA >> 5] & bitA))
+			{
+				continue;
+			}
+
+			if (dynamicB && (bodySet[vc->indexB >> 5] & bitB))
+			{
+				continue;
+			}
+
+			if (dynamicA)
+			{
+				bodySet[vc->indexA >> 5] |= bitA;
+			}
+
+			if (dynamicB)
+			{
+				bodySet[vc->indexB >> 5] |= bitB;
+			}
+
+			color = j;
+			break;
+		}
+
+		m_colors[i] = color;
+		++colorCounts[color];
+	}
+
+	m_allocator->Free(bodySets);
+
+	// Assign lanes in constraint order within each color. Each overflow
+	// constraint gets a batch of its own.
+	int32 colorLanes[b2_wideColorCount + 1];
+	m_batchCount = 0;
+	for (int32 i = 0; i < b2_wideColorCount; ++i)
+	{
+		colorLanes[i] = m_batchCount * width;
+		m_batchCount += (colorCounts[i] + width - 1) / width;
+	}
+	colorLanes[b2_wideColorCount] = m_batchCount * width;
+	m_batchCount += colorCounts[b2_wideColorCount];
+
+	m_lanes = (int32*)m_allocator->Allocate(m_batchCount * width * sizeof(int32));
+	for (int32 i = 0; i < m_batchCount * width; ++i)
+	{
+		m_lanes[i] = -1;
+	}
+
+	for (int32 i = 0; i < count; ++i)
+	{
+		int32 color = m_colors[i];
+		m_lanes[colorLanes[color]] = i;
+		colorLanes[color] += color < b2_wideColorCount ? 1 : width;
+	}
+
+	m_batches = m_allocator->Allocate(m_batchCount * m_kernels->batchSize);
+	m_kernels->pack(m_batches, m_lanes, m_batchCount, m_constraints);
+}
+
+b2WideContactSolver::~b2WideContactSolver()
+{
+	m_allocator->Free(m_batches);
+	m_allocator->Free(m_lanes);
+	m_allocator->Free(m_colors);
+}
+
+void b2WideContactSolver::WarmStart()
+{
+	m_kernels->warmStart(m_batches, m_batchCount, m_velocities);
+}
+
+void b2WideContactSolver::SolveVelocityConstraints()
+{
+	m_kernels->solve(m_batches, m_batchCount, m_velocities);
+}
+
+void b2WideContactSolver::StoreImpulses()
+{
+	m_kernels->store(m_batches, m_batchCount, m_constraints);
+}
@@ -0,0 +1,70 @@
+/*
+* Copyright (c) 2006-2011 Erin Catto http://www.box2d.org
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef B2_WIDE_CONTACT_SOLVER_H
+#define B2_WIDE_CONTACT_SOLVER_H
+
+#include "Box2D/Common/b2Settings.h"
+
+struct b2ContactVelocityConstraint;
+struct b2Velocity;
+class b2StackAllocator;
+
+// SIMD solver kernels for one instruction set.
+struct b2WideContactKernels
+{
+	int32 width;
+	int32 batchSize;
+	void (*pack)(void* batches, const int32* lanes, int32 batchCount, const b2ContactVelocityConstraint* constraints);
+	void (*store)(const void* batches, int32 batchCount, b2ContactVelocityConstraint* constraints);
+	void (*warmStart)(void* batches, int32 batchCount, b2Velocity* velocities);
+	void (*solve)(void* batches, int32 batchCount, b2Velocity* velocities);
+};
+
+// Solves contact velocity constraints several at a time using SSE2 or AVX2,
+// picked at runtime. The contact graph is colored so that no two constraints
+// in a batch share a dynamic body. This is used by b2ContactSolver when wide
+// solving is enabled on the world.
+class b2WideContactSolver
+{
+public:
+	// Get the kernels for this CPU, or nullptr if it has none.
+	static const b2WideContactKernels* GetKernels();
+
+	b2WideContactSolver(const b2WideContactKernels* kernels, b2ContactVelocityConstraint* constraints, int32 count,
+						b2Velocity* velocities, b2StackAllocator* allocator);
+	~b2WideContactSolver();
+
+	void WarmStart();
+	void SolveVelocityConstraints();
+
+	// Copy the accumulated impulses back to the velocity constraints.
+	void StoreImpulses();
+
+	const b2WideContactKernels* m_kernels;
+	b2ContactVelocityConstraint* m_constraints;
+	b2Velocity* m_velocities;
+	b2StackAllocator* m_allocator;
+	int32* m_colors;
+	int32* m_lanes;
+	void* m_batches;
+	int32 m_batchCount;
+};
+
+#endif
@@ -21,6 +21,8 @@
 #include "Box2D/Dynamics/b2Fixture.h"
 #include "Box2D/Dynamics/b2WorldCallbacks.h"
 #include "Box2D/Dynamics/Contacts/b2Contact.h"
+#include "Box2D/Common/b2StackAllocator.h"
+#include "Box2D/Common/b2TaskScheduler.h"
 
 b2ContactFilter b2_defaultFilter;
 b2ContactListener b2_defaultListener;
@@ -32,6 +34,8 @@ b2ContactManager::b2ContactManager()
 	m_contactFilter = &b2_defaultFilter;
 	m_contactListener = &b2_defaultListener;
 	m_allocator = nullptr;
+	m_stackAllocator = nullptr;
+	m_taskScheduler = nullptr;
 }
 
 void b2ContactManager::Destroy(b2Contact* c)
@@ -99,11 +103,44 @@ void b2ContactManager::Destroy(b2Contact* c)
 	--m_contactCount;
 }
 
+void b2ContactManager::Clear(bool freeContacts)
+{
+	if (m_contactListener || freeContacts)
+	{
+		b2Contact* c = m_contactList;
+		while (c)
+		{
+			b2Contact* next = c->m_next;
+
+			if (m_contactListener && c->IsTouching())
+			{
+				m_contactListener->EndContact(c);
+			}
+
+			if (freeContacts)
+			{
+				b2Contact::Destroy(c, m_allocator);
+			}
+
+			c = next;
+		}
+	}
+
+	m_contactList = nullptr;
+	m_contactCount = 0;
+}
+
 // This is the top level collision call for the time step. Here
 // all the narrow phase collision is processed for the world
 // contact list.
 void b2ContactManager::Collide()
 {
+	if (m_taskScheduler && m_contactCount > 0)
+	{
+		CollideParallel();
+		return;
+	}
+
 	// Update awake contacts.
 	b2Contact* c = m_contactList;
 	while (c)
@@ -169,9 +206,157 @@ void b2ContactManager::Collide()
 	}
 }
 
+// What the parallel pass of CollideParallel found for a contact.
+enum b2ContactAction
+{
+	e_skipContact,
+	e_updateContact,
+	e_destroyContact
+};
+
+struct b2ContactUpdate
+{
+	b2Contact* contact;
+	b2ContactAction action;
+	uint32 events;
+	b2Manifold oldManifold;
+};
+
+void b2ContactManager::UpdateContactsTask(int32 begin, int32 end, int32 threadIndex, void* context)
+{
+	B2_NOT_USED(threadIndex);
+
+	b2ContactUpdate* updates = (b2ContactUpdate*)context;
+	for (int32 i = begin; i < end; ++i)
+	{
+		b2ContactUpdate* update = updates + i;
+		if (update->action == e_updateContact)
+		{
+			update->events = update->contact->UpdateManifold(&update->oldManifold);
+		}
+	}
+}
+
+void b2ContactManager::CollideParallel()
+{
+	b2ContactUpdate* updates = (b2ContactUpdate*)m_stackAllocator->Allocate(m_contactCount * sizeof(b2ContactUpdate));
+	int32 updateCount = 0;
+
+	// Update the manifolds of the contacts that are active now in parallel.
+	// Collide only ever wakes bodies, so these are still active when the
+	// contacts are replayed below, and a manifold only depends on the body
+	// transforms, which Collide doesn't change. Contacts flagged for
+	// filtering are left to the replay, so the contact filter is called in
+	// the same order as in Collide and a filtered contact is never touched.
+	for (b2Contact* c = m_contactList; c; c = c->GetNext())
+	{
+		b2Fixture* fixtureA = c->GetFixtureA();
+		b2Fixture* fixtureB = c->GetFixtureB();
+		b2Body* bodyA = fixtureA->GetBody();
+		b2Body* bodyB = fixtureB->GetBody();
+
+		b2ContactUpdate* update = updates + updateCount;
+		update->contact = c;
+		update->action = e_skipContact;
+		update->events = 0;
+		++updateCount;
+
+		if (c->m_flags & b2Contact::e_filterFlag)
+		{
+			continue;
+		}
+
+		bool activeA = bodyA->IsAwake() && bodyA->m_type != b2_staticBody;
+		bool activeB = bodyB->IsAwake() && bodyB->m_type != b2_staticBody;
+		if (activeA == false && activeB == false)
+		{
+			continue;
+		}
+
+		int32 proxyIdA = fixtureA->m_proxies[c->GetChildIndexA()].proxyId;
+		int32 proxyIdB = fixtureB->m_proxies[c->GetChildIndexB()].proxyId;
+		bool overlap = m_broadPhase.TestOverlap(proxyIdA, proxyIdB);
+		update->action = overlap ? e_updateContact : e_destroyContact;
+	}
+
+	b2TaskHandle handle = m_taskScheduler->ParallelFor(updateCount, 32, UpdateContactsTask, updates);
+	m_taskScheduler->Wait(handle);
+
+	// Replay the contacts in order, making the same decisions and callbacks
+	// as Collide. A contact that only became active because an earlier one
+	// woke its body is updated here, as Collide would.
+	for (int32 i = 0; i < updateCount; ++i)
+	{
+		b2ContactUpdate* update = updates + i;
+		b2Contact* c = update->contact;
+		b2Fixture* fixtureA = c->GetFixtureA();
+		b2Fixture* fixtureB = c->GetFixtureB();
+		b2Body* bodyA = fixtureA->GetBody();
+		b2Body* bodyB = fixtureB->GetBody();
+
+		// Is this contact flagged for filtering?
+		if (c->m_flags & b2Contact::e_filterFlag)
+		{
+			// Should these bodies collide?
+			if (bodyB->ShouldCollide(bodyA) == false)
+			{
+				Destroy(c);
+				continue;
+			}
+
+			// Check user filtering.
+			if (m_contactFilter && m_contactFilter->ShouldCollide(fixtureA, fixtureB) == false)
+			{
+				Destroy(c);
+				continue;
+			}
+
+			// Clear the filtering flag.
+			c->m_flags &= ~b2Contact::e_filterFlag;
+		}
+
+		if (update->action == e_updateContact)
+		{
+			c->ReportUpdate(update->events, &update->oldManifold, m_contactListener);
+			continue;
+		}
+
+		if (update->action == e_destroyContact)
+		{
+			Destroy(c);
+			continue;
+		}
+
+		bool activeA = bodyA->IsAwake() && bodyA->m_type != b2_staticBody;
+		bool activeB = bodyB->IsAwake() && bodyB->m_type != b2_staticBody;
+
+		// At least one body must be awake and it must be dynamic or kinematic.
+		if (activeA == false && activeB == false)
+		{
+			continue;
+		}
+
+		int32 proxyIdA = fixtureA->m_proxies[c->GetChildIndexA()].proxyId;
+		int32 proxyIdB = fixtureB->m_proxies[c->GetChildIndexB()].proxyId;
+		bool overlap = m_broadPhase.TestOverlap(proxyIdA, proxyIdB);
+
+		// Here we destroy contacts that cease to overlap in the broad-phase.
+		if (overlap == false)
+		{
+			Destroy(c);
+			continue;
+		}
+
+		// The contact persists.
+		c->Update(m_contactListener);
+	}
+
+	m_stackAllocator->Free(updates);
+}
+
 void b2ContactManager::FindNewContacts()
 {
-	m_broadPhase.UpdatePairs(this);
+	m_broadPhase.UpdatePairs(this, m_taskScheduler);
 }
 
 void b2ContactManager::AddPair(void* proxyUserDataA, void* proxyUserDataB)
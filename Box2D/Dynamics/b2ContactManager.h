@@ -25,6 +25,8 @@ class b2Contact;
 class b2ContactFilter;
 class b2ContactListener;
 class b2BlockAllocator;
+class b2StackAllocator;
+class b2TaskScheduler;
 
 // Delegate of b2World.
 class b2ContactManager
@@ -39,7 +41,18 @@ public:
 
 	void Destroy(b2Contact* c);
 
+	// Destroy every contact, reporting the touching ones as ended. The
+	// bodies' contact lists are left for the caller to reset. Pass false
+	// for freeContacts if the block allocator is about to be cleared.
+	void Clear(bool freeContacts);
+
 	void Collide();
+
+	// Collide with the manifolds updated on the task scheduler. Filtering,
+	// waking, destruction and listener calls stay on the calling thread and
+	// happen in contact list order.
+	void CollideParallel();
+	static void UpdateContactsTask(int32 begin, int32 end, int32 threadIndex, void* context);
             
 	b2BroadPhase m_broadPhase;
 	b2Contact* m_contactList;
@@ -47,6 +60,8 @@ public:
 	b2ContactFilter* m_contactFilter;
 	b2ContactListener* m_contactListener;
 	b2BlockAllocator* m_allocator;
+	b2StackAllocator* m_stackAllocator;
+	b2TaskScheduler* m_taskScheduler;
 };
 
 #endif
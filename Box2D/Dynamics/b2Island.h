@@ -34,8 +34,14 @@ struct b2Profile;
 class b2Island
 {
 public:
+	/// @param positions, velocities body state arrays owned by the caller,
+	/// or nullptr to allocate them. Static bodies shared between islands
+	/// solved in parallel live in sharedCapacity slots in front of them,
+	/// at a negative island index assigned by the world.
 	b2Island(int32 bodyCapacity, int32 contactCapacity, int32 jointCapacity,
-			b2StackAllocator* allocator, b2ContactListener* listener);
+			b2StackAllocator* allocator, b2ContactListener* listener,
+			b2Position* positions = nullptr, b2Velocity* velocities = nullptr,
+			int32 sharedCapacity = 0);
 	~b2Island();
 
 	void Clear()
@@ -57,6 +63,18 @@ public:
 		++m_bodyCount;
 	}
 
+	/// Initialize the shared state slot of a static body. The world assigns
+	/// its negative island index before the islands are solved.
+	void AddShared(const b2Body* body)
+	{
+		int32 index = body->m_islandIndex;
+		b2Assert(-m_sharedCapacity <= index && index < 0);
+		m_positions[index].c = body->m_sweep.c;
+		m_positions[index].a = body->m_sweep.a;
+		m_velocities[index].v = body->m_linearVelocity;
+		m_velocities[index].w = body->m_angularVelocity;
+	}
+
 	void Add(b2Contact* contact)
 	{
 		b2Assert(m_contactCount < m_contactCapacity);
@@ -88,6 +106,8 @@ public:
 	int32 m_bodyCapacity;
 	int32 m_contactCapacity;
 	int32 m_jointCapacity;
+	int32 m_sharedCapacity;
+	bool m_ownsState;
 };
 
 #endif
@@ -32,6 +32,8 @@
 #include "Box2D/Collision/b2TimeOfImpact.h"
 #include "Box2D/Common/b2Draw.h"
 #include "Box2D/Common/b2Timer.h"
+#include "Box2D/Common/b2WorkStealingScheduler.h"
+#include <algorithm>
 #include <new>
 
 b2World::b2World(const b2Vec2& gravity)
@@ -48,6 +50,7 @@ b2World::b2World(const b2Vec2& gravity)
 	m_warmStarting = true;
 	m_continuousPhysics = true;
 	m_subStepping = false;
+	m_wideSolving = false;
 
 	m_stepComplete = true;
 
@@ -59,6 +62,12 @@ b2World::b2World(const b2Vec2& gravity)
 	m_inv_dt0 = 0.0f;
 
 	m_contactManager.m_allocator = &m_blockAllocator;
+	m_contactManager.m_stackAllocator = &m_stackAllocator;
+
+	m_taskScheduler = nullptr;
+	m_ownedScheduler = nullptr;
+	m_threadAllocators = nullptr;
+	m_threadAllocatorCount = 0;
 
 	memset(&m_profile, 0, sizeof(b2Profile));
 }
@@ -82,6 +91,8 @@ b2World::~b2World()
 
 		b = bNext;
 	}
+
+	SetTaskScheduler(nullptr);
 }
 
 void b2World::SetDestructionListener(b2DestructionListener* listener)
@@ -104,6 +115,73 @@ void b2World::SetDebugDraw(b2Draw* debugDraw)
 	g_debugDraw = debugDraw;
 }
 
+void b2World::SetTaskScheduler(b2TaskScheduler* scheduler)
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
+
+	if (m_ownedScheduler && m_ownedScheduler != scheduler)
+	{
+		m_ownedScheduler->~b2WorkStealingScheduler();
+		b2Free(m_ownedScheduler);
+		m_ownedScheduler = nullptr;
+	}
+
+	for (int32 i = 0; i < m_threadAllocatorCount; ++i)
+	{
+		m_threadAllocators[i].~b2StackAllocator();
+	}
+	b2Free(m_threadAllocators);
+	m_threadAllocators = nullptr;
+	m_threadAllocatorCount = 0;
+
+	m_taskScheduler = scheduler;
+	m_contactManager.m_taskScheduler = scheduler;
+
+	if (m_taskScheduler)
+	{
+		m_threadAllocatorCount = m_taskScheduler->GetThreadCount();
+		m_threadAllocators = (b2StackAllocator*)b2Alloc(m_threadAllocatorCount * sizeof(b2StackAllocator));
+		for (int32 i = 0; i < m_threadAllocatorCount; ++i)
+		{
+			new (m_threadAllocators + i) b2StackAllocator;
+		}
+	}
+}
+
+void b2World::SetThreadCount(int32 count)
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
+
+	if (count == GetThreadCount() && m_taskScheduler == m_ownedScheduler)
+	{
+		return;
+	}
+
+	if (count <= 1)
+	{
+		SetTaskScheduler(nullptr);
+		return;
+	}
+
+	void* mem = b2Alloc(sizeof(b2WorkStealingScheduler));
+	b2WorkStealingScheduler* scheduler = new (mem) b2WorkStealingScheduler(count);
+	SetTaskScheduler(scheduler);
+	m_ownedScheduler = scheduler;
+}
+
+int32 b2World::GetThreadCount() const
+{
+	return m_taskScheduler ? m_taskScheduler->GetThreadCount() : 1;
+}
+
 b2Body* b2World::CreateBody(const b2BodyDef* def)
 {
 	b2Assert(IsLocked() == false);
@@ -209,6 +287,226 @@ void b2World::DestroyBody(b2Body* b)
 	m_blockAllocator.Free(b, sizeof(b2Body));
 }
 
+void b2World::Clear(bool keepStaticBodies)
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
+
+	// Say goodbye in the same order as DestroyBody: the joints, then the
+	// contacts end as they are destroyed, then the fixtures.
+	b2DestructionListener* listener = m_destructionListener;
+	b2Joint** joints = nullptr;
+	b2Fixture** fixtures = nullptr;
+	int32 jointCount = 0;
+	int32 fixtureCount = 0;
+	if (listener)
+	{
+		for (b2Body* b = m_bodyList; b; b = b->m_next)
+		{
+			if ((keepStaticBodies && b->m_type == b2_staticBody) == false)
+			{
+				fixtureCount += b->m_fixtureCount;
+			}
+		}
+
+		joints = (b2Joint**)m_stackAllocator.Allocate(m_jointCount * sizeof(b2Joint*));
+		fixtures = (b2Fixture**)m_stackAllocator.Allocate(fixtureCount * sizeof(b2Fixture*));
+
+		for (b2Joint* j = m_jointList; j; j = j->m_next)
+		{
+			if (keepStaticBodies == false || j->m_bodyA->m_type != b2_staticBody || j->m_bodyB->m_type != b2_staticBody)
+			{
+				joints[jointCount++] = j;
+			}
+		}
+
+		fixtureCount = 0;
+		for (b2Body* b = m_bodyList; b; b = b->m_next)
+		{
+			if ((keepStaticBodies && b->m_type == b2_staticBody) == false)
+			{
+				for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+				{
+					fixtures[fixtureCount++] = f;
+				}
+			}
+		}
+
+		if (jointCount > 0)
+		{
+			listener->SayGoodbyeToJoints(joints, jointCount);
+		}
+	}
+
+	// Every contact has a non-static body, so none survive.
+	m_contactManager.Clear(keepStaticBodies);
+
+	if (listener)
+	{
+		if (fixtureCount > 0)
+		{
+			listener->SayGoodbyeToFixtures(fixtures, fixtureCount);
+		}
+
+		m_stackAllocator.Free(fixtures);
+		m_stackAllocator.Free(joints);
+	}
+
+	if (keepStaticBodies == false)
+	{
+		// Like the destructor, only run the shape destructors since some shapes
+		// allocate using b2Alloc. Everything else goes with the block allocator.
+		for (b2Body* b = m_bodyList; b; b = b->m_next)
+		{
+			for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+			{
+				f->m_shape->~b2Shape();
+			}
+		}
+
+		m_contactManager.m_broadPhase.Clear();
+		m_blockAllocator.Clear();
+
+		m_bodyList = nullptr;
+		m_jointList = nullptr;
+		m_bodyCount = 0;
+		m_jointCount = 0;
+		return;
+	}
+
+	// Keep the joints between static bodies and link them to their bodies again.
+	// This must come before any body is freed.
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		b->m_jointList = nullptr;
+	}
+
+	b2Joint* j = m_jointList;
+	m_jointList = nullptr;
+	m_jointCount = 0;
+	while (j)
+	{
+		b2Joint* next = j->m_next;
+
+		if (j->m_bodyA->m_type == b2_staticBody && j->m_bodyB->m_type == b2_staticBody)
+		{
+			j->m_prev = nullptr;
+			j->m_next = m_jointList;
+			if (m_jointList)
+			{
+				m_jointList->m_prev = j;
+			}
+			m_jointList = j;
+			++m_jointCount;
+
+			j->m_edgeA.prev = nullptr;
+			j->m_edgeA.next = j->m_bodyA->m_jointList;
+			if (j->m_bodyA->m_jointList) j->m_bodyA->m_jointList->prev = &j->m_edgeA;
+			j->m_bodyA->m_jointList = &j->m_edgeA;
+
+			j->m_edgeB.prev = nullptr;
+			j->m_edgeB.next = j->m_bodyB->m_jointList;
+			if (j->m_bodyB->m_jointList) j->m_bodyB->m_jointList->prev = &j->m_edgeB;
+			j->m_bodyB->m_jointList = &j->m_edgeB;
+		}
+		else
+		{
+			b2Joint::Destroy(j, &m_blockAllocator);
+		}
+
+		j = next;
+	}
+
+	// Start the broad-phase over and put back the proxies of the static bodies.
+	b2BroadPhase* broadPhase = &m_contactManager.m_broadPhase;
+	broadPhase->Clear();
+	broadPhase->BeginBulkInsert();
+
+	b2Body* b = m_bodyList;
+	b2Body* tail = nullptr;
+	m_bodyList = nullptr;
+	m_bodyCount = 0;
+	while (b)
+	{
+		b2Body* next = b->m_next;
+
+		if (b->m_type == b2_staticBody)
+		{
+			b->m_contactList = nullptr;
+
+			// Inactive bodies have no proxies and get them when activated.
+			for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+			{
+				f->m_proxyCount = 0;
+				if (b->m_flags & b2Body::e_activeFlag)
+				{
+					f->CreateProxies(broadPhase, b->m_xf);
+				}
+			}
+
+			b->m_prev = tail;
+			b->m_next = nullptr;
+			if (tail)
+			{
+				tail->m_next = b;
+			}
+			else
+			{
+				m_bodyList = b;
+			}
+			tail = b;
+			++m_bodyCount;
+		}
+		else
+		{
+			b2Fixture* f = b->m_fixtureList;
+			while (f)
+			{
+				b2Fixture* f0 = f;
+				f = f->m_next;
+
+				f0->m_proxyCount = 0;
+				f0->Destroy(&m_blockAllocator);
+				f0->~b2Fixture();
+				m_blockAllocator.Free(f0, sizeof(b2Fixture));
+			}
+
+			b->~b2Body();
+			m_blockAllocator.Free(b, sizeof(b2Body));
+		}
+
+		b = next;
+	}
+
+	broadPhase->EndBulkInsert();
+	m_flags |= e_newFixture;
+}
+
+void b2World::BeginBulkCreate()
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
+
+	m_contactManager.m_broadPhase.BeginBulkInsert();
+}
+
+void b2World::EndBulkCreate()
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
+
+	m_contactManager.m_broadPhase.EndBulkInsert();
+}
+
 b2Joint* b2World::CreateJoint(const b2JointDef* def)
 {
 	b2Assert(IsLocked() == false);
@@ -382,6 +680,289 @@ void b2World::SetAllowSleeping(bool flag)
 	}
 }
 
+// An island gathered for parallel solving. The ranges index the flat
+// arrays of the owning batch.
+struct b2IslandRange
+{
+	int32 bodyStart, bodyCount;
+	int32 staticStart, staticCount;
+	int32 contactStart, contactCount;
+	int32 jointStart, jointCount;
+	b2Profile profile;
+};
+
+// All islands of a step, collected by the DFS in b2World::Solve. Static
+// bodies are kept apart from the island bodies because several islands
+// may share them.
+struct b2IslandBatch
+{
+	void Add(const b2Island& island)
+	{
+		b2IslandRange* range = islands + islandCount++;
+		range->bodyStart = bodyCount;
+		range->staticStart = staticCount;
+		for (int32 i = 0; i < island.m_bodyCount; ++i)
+		{
+			b2Body* b = island.m_bodies[i];
+			if (b->GetType() == b2_staticBody)
+			{
+				statics[staticCount++] = b;
+			}
+			else
+			{
+				bodies[bodyCount++] = b;
+			}
+		}
+		range->bodyCount = bodyCount - range->bodyStart;
+		range->staticCount = staticCount - range->staticStart;
+
+		range->contactStart = contactCount;
+		range->contactCount = island.m_contactCount;
+		memcpy(contacts + contactCount, island.m_contacts, island.m_contactCount * sizeof(b2Contact*));
+		contactCount += island.m_contactCount;
+
+		range->jointStart = jointCount;
+		range->jointCount = island.m_jointCount;
+		memcpy(joints + jointCount, island.m_joints, island.m_jointCount * sizeof(b2Joint*));
+		jointCount += island.m_jointCount;
+	}
+
+	b2IslandRange* islands;
+	b2Body** bodies;
+	b2Body** statics;
+	b2Contact** contacts;
+	b2Joint** joints;
+	int32 islandCount;
+	int32 bodyCount;
+	int32 staticCount;
+	int32 contactCount;
+	int32 jointCount;
+};
+
+// Records the PostSolve impulses of one island so they can be reported on
+// the calling thread once all islands are solved.
+class b2ImpulseRecorder : public b2ContactListener
+{
+public:
+	void PostSolve(b2Contact* contact, const b2ContactImpulse* impulse) override
+	{
+		B2_NOT_USED(contact);
+		m_impulses[m_count++] = *impulse;
+	}
+
+	b2ContactImpulse* m_impulses;
+	int32 m_count;
+};
+
+struct b2IslandSolveContext
+{
+	b2IslandBatch* batch;
+	const int32* order;
+	b2ContactImpulse* impulses;
+	b2StackAllocator* allocators;
+	b2Position* positions;
+	b2Velocity* velocities;
+	int32 sharedCount;
+	int32 stateStride;
+	b2TimeStep step;
+	b2Vec2 gravity;
+	bool allowSleep;
+};
+
+// Solves one island on a scheduler thread.
+static void b2SolveIsland(b2IslandSolveContext* ctx, int32 index, int32 threadIndex)
+{
+	b2IslandBatch* batch = ctx->batch;
+	b2IslandRange* range = batch->islands + ctx->order[index];
+
+	b2ImpulseRecorder recorder;
+	recorder.m_impulses = ctx->impulses + range->contactStart;
+	recorder.m_count = 0;
+	b2ContactListener* listener = ctx->impulses ? &recorder : nullptr;
+
+	// The state arrays of this thread, behind its copy of the shared slots.
+	int32 stateOffset = threadIndex * ctx->stateStride + ctx->sharedCount;
+	b2Island island(range->bodyCount,
+					range->contactCount,
+					range->jointCount,
+					ctx->allocators + threadIndex,
+					listener,
+					ctx->positions + stateOffset,
+					ctx->velocities + stateOffset,
+					ctx->sharedCount);
+
+	for (int32 i = 0; i < range->bodyCount; ++i)
+	{
+		island.Add(batch->bodies[range->bodyStart + i]);
+	}
+
+	// Load this island's static bodies into this thread's shared slots.
+	// The solver never writes them back to the bodies.
+	for (int32 i = 0; i < range->staticCount; ++i)
+	{
+		island.AddShared(batch->statics[range->staticStart + i]);
+	}
+
+	for (int32 i = 0; i < range->contactCount; ++i)
+	{
+		island.Add(batch->contacts[range->contactStart + i]);
+	}
+
+	for (int32 i = 0; i < range->jointCount; ++i)
+	{
+		island.Add(batch->joints[range->jointStart + i]);
+	}
+
+	island.Solve(&range->profile, ctx->step, ctx->gravity, ctx->allowSleep);
+}
+
+static void b2SolveIslandTask(int32 begin, int32 end, int32 threadIndex, void* context)
+{
+	b2IslandSolveContext* ctx = (b2IslandSolveContext*)context;
+	for (int32 i = begin; i < end; ++i)
+	{
+		b2SolveIsland(ctx, i, threadIndex);
+	}
+}
+
+// Orders islands largest first so the long ones start early.
+struct b2IslandCostGreater
+{
+	bool operator()(int32 a, int32 b) const
+	{
+		const b2IslandRange* ra = islands + a;
+		const b2IslandRange* rb = islands + b;
+		int32 costA = ra->bodyCount + ra->contactCount + ra->jointCount;
+		int32 costB = rb->bodyCount + rb->contactCount + rb->jointCount;
+		if (costA != costB)
+		{
+			return costA > costB;
+		}
+		return a < b;
+	}
+
+	const b2IslandRange* islands;
+};
+
+// Solve the collected islands on the task scheduler, then report and
+// finish them on this thread in collection order.
+void b2World::SolveIslands(b2IslandBatch* batch, const b2TimeStep& step)
+{
+	if (batch->islandCount == 0)
+	{
+		return;
+	}
+
+	// Give every static body touched this step one shared state slot in
+	// front of the island state arrays. All islands then agree on its
+	// (negative) island index and no island writes to the body.
+	for (int32 i = 0; i < batch->staticCount; ++i)
+	{
+		batch->statics[i]->m_islandIndex = -1;
+	}
+
+	int32 sharedCount = 0;
+	for (int32 i = 0; i < batch->staticCount; ++i)
+	{
+		b2Body* b = batch->statics[i];
+		if (b->m_islandIndex == -1)
+		{
+			b->m_islandIndex = sharedCount++;
+		}
+	}
+
+	for (int32 i = 0; i < batch->staticCount; ++i)
+	{
+		b2Body* b = batch->statics[i];
+		if (b->m_islandIndex >= 0)
+		{
+			b->m_islandIndex -= sharedCount;
+		}
+	}
+
+	// A thread solves its islands one at a time, so it only needs one set
+	// of state arrays: the shared slots, then room for its largest island.
+	int32 maxBodyCount = 0;
+	int32* order = (int32*)m_stackAllocator.Allocate(batch->islandCount * sizeof(int32));
+	for (int32 i = 0; i < batch->islandCount; ++i)
+	{
+		order[i] = i;
+		maxBodyCount = b2Max(maxBodyCount, batch->islands[i].bodyCount);
+	}
+	b2IslandCostGreater greater;
+	greater.islands = batch->islands;
+	std::sort(order, order + batch->islandCount, greater);
+
+	b2ContactListener* listener = m_contactManager.m_contactListener;
+	b2ContactImpulse* impulses = nullptr;
+	if (listener)
+	{
+		impulses = (b2ContactImpulse*)m_stackAllocator.Allocate(b2Max(batch->contactCount, 1) * sizeof(b2ContactImpulse));
+	}
+
+	int32 stateStride = sharedCount + maxBodyCount;
+	int32 stateCount = m_threadAllocatorCount * stateStride;
+	b2Velocity* velocities = (b2Velocity*)m_stackAllocator.Allocate(stateCount * sizeof(b2Velocity));
+	b2Position* positions = (b2Position*)m_stackAllocator.Allocate(stateCount * sizeof(b2Position));
+
+	b2IslandSolveContext context;
+	context.batch = batch;
+	context.order = order;
+	context.impulses = impulses;
+	context.allocators = m_threadAllocators;
+	context.positions = positions;
+	context.velocities = velocities;
+	context.sharedCount = sharedCount;
+	context.stateStride = stateStride;
+	context.step = step;
+	context.gravity = m_gravity;
+	context.allowSleep = m_allowSleep;
+
+	b2TaskHandle handle = m_taskScheduler->ParallelFor(batch->islandCount, 1, b2SolveIslandTask, &context);
+	m_taskScheduler->Wait(handle);
+
+	for (int32 i = 0; i < batch->islandCount; ++i)
+	{
+		const b2IslandRange* range = batch->islands + i;
+		m_profile.solveInit += range->profile.solveInit;
+		m_profile.solveVelocity += range->profile.solveVelocity;
+		m_profile.solvePosition += range->profile.solvePosition;
+
+		if (impulses)
+		{
+			for (int32 j = 0; j < range->contactCount; ++j)
+			{
+				int32 index = range->contactStart + j;
+				listener->PostSolve(batch->contacts[index], impulses + index);
+			}
+		}
+
+		// The serial solver puts the static bodies of a sleeping island to
+		// sleep and wakes them again when a later island touches them.
+		bool sleeping = batch->bodies[range->bodyStart]->IsAwake() == false;
+		for (int32 j = 0; j < range->staticCount; ++j)
+		{
+			b2Body* b = batch->statics[range->staticStart + j];
+			if (sleeping)
+			{
+				b->SetAwake(false);
+			}
+			else
+			{
+				b->m_flags |= b2Body::e_awakeFlag;
+			}
+		}
+	}
+
+	m_stackAllocator.Free(positions);
+	m_stackAllocator.Free(velocities);
+	if (impulses)
+	{
+		m_stackAllocator.Free(impulses);
+	}
+	m_stackAllocator.Free(order);
+}
+
 // Find islands, integrate and solve constraints, solve position constraints
 void b2World::Solve(const b2TimeStep& step)
 {
@@ -413,6 +994,25 @@ void b2World::Solve(const b2TimeStep& step)
 	// Build and simulate all awake islands.
 	int32 stackSize = m_bodyCount;
 	b2Body** stack = (b2Body**)m_stackAllocator.Allocate(stackSize * sizeof(b2Body*));
+
+	// With a task scheduler the islands are only collected by the search and
+	// solved together afterwards.
+	b2IslandBatch batch;
+	if (m_taskScheduler)
+	{
+		int32 contactCount = m_contactManager.m_contactCount;
+		batch.islands = (b2IslandRange*)m_stackAllocator.Allocate(b2Max(m_bodyCount, 1) * sizeof(b2IslandRange));
+		batch.bodies = (b2Body**)m_stackAllocator.Allocate(b2Max(m_bodyCount, 1) * sizeof(b2Body*));
+		batch.statics = (b2Body**)m_stackAllocator.Allocate(b2Max(contactCount + m_jointCount, 1) * sizeof(b2Body*));
+		batch.contacts = (b2Contact**)m_stackAllocator.Allocate(b2Max(contactCount, 1) * sizeof(b2Contact*));
+		batch.joints = (b2Joint**)m_stackAllocator.Allocate(b2Max(m_jointCount, 1) * sizeof(b2Joint*));
+		batch.islandCount = 0;
+		batch.bodyCount = 0;
+		batch.staticCount = 0;
+		batch.contactCount = 0;
+		batch.jointCount = 0;
+	}
+
 	for (b2Body* seed = m_bodyList; seed; seed = seed->m_next)
 	{
 		if (seed->m_flags & b2Body::e_islandFlag)
@@ -527,11 +1127,18 @@ void b2World::Solve(const b2TimeStep& step)
 			}
 		}
 
-		b2Profile profile;
-		island.Solve(&profile, step, m_gravity, m_allowSleep);
-		m_profile.solveInit += profile.solveInit;
-		m_profile.solveVelocity += profile.solveVelocity;
-		m_profile.solvePosition += profile.solvePosition;
+		if (m_taskScheduler)
+		{
+			batch.Add(island);
+		}
+		else
+		{
+			b2Profile profile;
+			island.Solve(&profile, step, m_gravity, m_allowSleep);
+			m_profile.solveInit += profile.solveInit;
+			m_profile.solveVelocity += profile.solveVelocity;
+			m_profile.solvePosition += profile.solvePosition;
+		}
 
 		// Post solve cleanup.
 		for (int32 i = 0; i < island.m_bodyCount; ++i)
@@ -545,6 +1152,17 @@ void b2World::Solve(const b2TimeStep& step)
 		}
 	}
 
+	if (m_taskScheduler)
+	{
+		SolveIslands(&batch, step);
+
+		m_stackAllocator.Free(batch.joints);
+		m_stackAllocator.Free(batch.contacts);
+		m_stackAllocator.Free(batch.statics);
+		m_stackAllocator.Free(batch.bodies);
+		m_stackAllocator.Free(batch.islands);
+	}
+
 	m_stackAllocator.Free(stack);
 
 	{
@@ -860,6 +1478,7 @@ void b2World::SolveTOI(const b2TimeStep& step)
 		subStep.positionIterations = 20;
 		subStep.velocityIterations = step.velocityIterations;
 		subStep.warmStarting = false;
+		subStep.wideSolving = false;
 		island.SolveTOI(subStep, bA->m_islandIndex, bB->m_islandIndex);
 
 		// Reset island flags and synchronize broad-phase proxies.
@@ -923,6 +1542,7 @@ void b2World::Step(float32 dt, int32 velocityIterations, int32 positionIteration
 	step.dtRatio = m_inv_dt0 * dt;
 
 	step.warmStarting = m_warmStarting;
+	step.wideSolving = m_wideSolving;
 	
 	// Update contacts. This is where some contacts are destroyed.
 	{
@@ -34,6 +34,9 @@ class b2Body;
 class b2Draw;
 class b2Fixture;
 class b2Joint;
+class b2TaskScheduler;
+class b2WorkStealingScheduler;
+struct b2IslandBatch;
 
 /// The world class manages all physics entities, dynamic simulation,
 /// and asynchronous queries. The world also contains efficient memory
@@ -86,6 +89,23 @@ public:
 	/// @warning This function is locked during callbacks.
 	void DestroyJoint(b2Joint* joint);
 
+	/// Destroy all bodies, joints and contacts in one pass. This is much faster than
+	/// calling DestroyBody for each body: nothing is unlinked one by one, and the broad-phase
+	/// is rebuilt once from the remaining proxies. As with DestroyBody, the destruction
+	/// listener gets the joints, then touching contacts are reported as ended, then the
+	/// listener gets the fixtures, with the joints and fixtures in two batched calls.
+	/// @param keepStaticBodies keep the static bodies and the joints between them.
+	/// @warning This function is locked during callbacks.
+	void Clear(bool keepStaticBodies = false);
+
+	/// Create many bodies faster. The fixtures created until EndBulkCreate get their
+	/// broad-phase proxies without the tree being updated, and EndBulkCreate builds the
+	/// tree once over all of them. In between, don't query, ray-cast or step the world,
+	/// and don't move or destroy bodies.
+	/// @warning This function is locked during callbacks.
+	void BeginBulkCreate();
+	void EndBulkCreate();
+
 	/// Take a time step. This performs collision detection, integration,
 	/// and constraint solution.
 	/// @param timeStep the amount of time to simulate, this should not vary.
@@ -157,6 +177,30 @@ public:
 	void SetSubStepping(bool flag) { m_subStepping = flag; }
 	bool GetSubStepping() const { return m_subStepping; }
 
+	/// Enable/disable the wide contact solver, which solves 4 or 8 contacts
+	/// at a time with SIMD instructions picked for the CPU. Contacts are
+	/// solved in a different order, so results differ from the default
+	/// solver. Has no effect on CPUs without SSE2.
+	void SetWideSolving(bool flag) { m_wideSolving = flag; }
+	bool GetWideSolving() const { return m_wideSolving; }
+
+	/// Register a task scheduler that runs the multithreaded stages of Step,
+	/// such as the narrow phase and island solving. The scheduler is owned by
+	/// you and must remain in scope. Pass nullptr to run everything on the
+	/// calling thread.
+	/// Contact listener callbacks are always made on the calling thread,
+	/// in the same order as without a scheduler.
+	/// @warning This function is locked during callbacks.
+	void SetTaskScheduler(b2TaskScheduler* scheduler);
+	b2TaskScheduler* GetTaskScheduler() const { return m_taskScheduler; }
+
+	/// Convenience for users without a job system: install a world owned
+	/// b2WorkStealingScheduler with the given number of threads, including
+	/// the calling thread. A count of 1 removes it.
+	/// @warning This function is locked during callbacks.
+	void SetThreadCount(int32 count);
+	int32 GetThreadCount() const;
+
 	/// Get the number of broad-phase proxies.
 	int32 GetProxyCount() const;
 
@@ -225,6 +269,7 @@ private:
 	friend class b2Controller;
 
 	void Solve(const b2TimeStep& step);
+	void SolveIslands(b2IslandBatch* batch, const b2TimeStep& step);
 	void SolveTOI(const b2TimeStep& step);
 
 	void DrawJoint(b2Joint* joint);
@@ -233,6 +278,13 @@ private:
 	b2BlockAllocator m_blockAllocator;
 	b2StackAllocator m_stackAllocator;
 
+	// Optional scheduler for the parallel stages, with a stack allocator
+	// per scheduler thread.
+	b2TaskScheduler* m_taskScheduler;
+	b2WorkStealingScheduler* m_ownedScheduler;
+	b2StackAllocator* m_threadAllocators;
+	int32 m_threadAllocatorCount;
+
 	int32 m_flags;
 
 	b2ContactManager m_contactManager;
@@ -257,6 +309,7 @@ private:
 	bool m_warmStarting;
 	bool m_continuousPhysics;
 	bool m_subStepping;
+	bool m_wideSolving;
 
 	bool m_stepComplete;
 
@@ -19,6 +19,22 @@
 #include "Box2D/Dynamics/b2WorldCallbacks.h"
 #include "Box2D/Dynamics/b2Fixture.h"
 
+void b2DestructionListener::SayGoodbyeToJoints(b2Joint** joints, int32 count)
+{
+	for (int32 i = 0; i < count; ++i)
+	{
+		SayGoodbye(joints[i]);
+	}
+}
+
+void b2DestructionListener::SayGoodbyeToFixtures(b2Fixture** fixtures, int32 count)
+{
+	for (int32 i = 0; i < count; ++i)
+	{
+		SayGoodbye(fixtures[i]);
+	}
+}
+
 // Return true if contact calculations should be performed between these two shapes.
 // If you implement your own collision filter you may want to build from this implementation.
 bool b2ContactFilter::ShouldCollide(b2Fixture* fixtureA, b2Fixture* fixtureB)
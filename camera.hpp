@@ -38,13 +38,24 @@ protected:
     Perspective pers;
 };
 
+// Orthographic view of a rectangle of the world. The rectangle it is
+// made with is the view at zoom 1; zooming in shrinks the view about a
+// point, and panning moves it.
 class Camera2D {
 public:
     Camera2D(vec2 worldMin=vec2(-1,-1), vec2 worldMax=vec2(1,1)):
-        worldMin(worldMin), worldMax(worldMax) {}
+        worldMin(worldMin), worldMax(worldMax),
+        center((worldMin+worldMax)/2.f), zoom(1) {}
     void apply(Engine *engine);
+    vec2 viewMin() const;
+    vec2 viewMax() const;
+    vec2 viewToWorld(vec2 u) const;
+    void zoomAt(vec2 point, float factor);
+    void pan(vec2 offset);
 protected:
     vec2 worldMin, worldMax;
+    vec2 center;
+    float zoom;
 };
 
 // Definitions below
@@ -93,10 +104,37 @@ inline void OrbitCamera::onMouseMotion(SDL_MouseMotionEvent &e) {
 }
 
 inline void Camera2D::apply(Engine *engine) {
+    vec2 vmin = viewMin(), vmax = viewMax();
     engine->matrixMode(GL_PROJECTION);
-    engine->setMatrix(glm::ortho(worldMin.x,worldMax.x,worldMin.y,worldMax.y));
+    engine->setMatrix(glm::ortho(vmin.x,vmax.x,vmin.y,vmax.y));
     engine->matrixMode(GL_MODELVIEW);
     engine->setMatrix(mat4());
 }
 
+inline vec2 Camera2D::viewMin() const {
+    return center - (worldMax - worldMin)/(2*zoom);
+}
+
+inline vec2 Camera2D::viewMax() const {
+    return center + (worldMax - worldMin)/(2*zoom);
+}
+
+// u is the position in the view, from (0,0) at the bottom left to (1,1)
+// at the top right.
+inline vec2 Camera2D::viewToWorld(vec2 u) const {
+    vec2 vmin = viewMin();
+    return vmin + u*(viewMax() - vmin);
+}
+
+// Scales the zoom by factor, keeping point where it is on screen.
+inline void Camera2D::zoomAt(vec2 point, float factor) {
+    float newZoom = glm::clamp(zoom*factor, 0.01f, 100.0f);
+    center = point + (center - point)*(zoom/newZoom);
+    zoom = newZoom;
+}
+
+inline void Camera2D::pan(vec2 offset) {
+    center += offset;
+}
+
 #endif
@@ -11,6 +11,10 @@ namespace Config {
     // Shaders
     const std::string shaderVert = shaderDir + "/constant2d.vert";
     const std::string shaderFrag = shaderDir + "/constant2d.frag";
+    const std::string instancedVert = shaderDir + "/instanced2d.vert";
+    const std::string instancedFrag = shaderDir + "/instanced2d.frag";
+    const std::string debugVert = shaderDir + "/debug2d.vert";
+    const std::string debugFrag = shaderDir + "/debug2d.frag";
 
 }
 
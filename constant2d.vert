@@ -1,12 +1,17 @@
 #version 150
 
-uniform mat4 modelViewMatrix;
-uniform mat4 projectionMatrix;
+// per-frame camera matrices, shared by all shaders
+layout(std140) uniform Camera {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+};
+
+uniform mat4 modelMatrix;
 
 in vec2 vertex;
 
 void main() {
 
-    gl_Position = projectionMatrix * modelViewMatrix * vec4(vertex,0,1);
+    gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(vertex,0,1);
 
 }
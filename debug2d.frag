@@ -0,0 +1,11 @@
+#version 150
+
+in vec4 color;
+
+out vec4 outColor;
+
+void main() {
+
+    outColor = color;
+
+}
@@ -0,0 +1,19 @@
+#version 150
+
+// per-frame camera matrices, shared by all shaders
+layout(std140) uniform Camera {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+};
+
+in vec2 vertex;
+in vec4 vertexColor;
+
+out vec4 color;
+
+void main() {
+
+    gl_Position = projectionMatrix * viewMatrix * vec4(vertex,0,1);
+    color = vertexColor;
+
+}
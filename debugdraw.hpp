@@ -0,0 +1,117 @@
+#ifndef DEBUGDRAW_HPP
+#define DEBUGDRAW_HPP
+
+#include <cmath>
+#include <vector>
+#include <glm/glm.hpp>
+#include <Box2D/Box2D.h>
+using glm::vec2;
+using glm::vec4;
+
+struct DebugVertex {
+    vec2 position;
+    vec4 color;
+};
+
+// Line segments (pairs of vertices) and triangles from one
+// b2World::DrawDebugData, ready to be drawn with one call each.
+struct DebugGeometry {
+    std::vector<DebugVertex> lines, triangles;
+    void clear() { lines.clear(); triangles.clear(); }
+};
+
+// b2Draw backend that only records: every call is turned into lines and
+// triangles appended to target, and Draw::debug draws them later. It
+// needs no OpenGL context, so it can run on the physics thread.
+class DebugDraw: public b2Draw {
+public:
+    DebugGeometry *target;
+    float pixelSize; // world units per pixel, for DrawPoint
+    DebugDraw(): target(NULL), pixelSize(0.0125f) {}
+    void DrawPolygon(const b2Vec2 *vertices, int32 vertexCount, const b2Color &color);
+    void DrawSolidPolygon(const b2Vec2 *vertices, int32 vertexCount, const b2Color &color);
+    void DrawCircle(const b2Vec2 &center, float32 radius, const b2Color &color);
+    void DrawSolidCircle(const b2Vec2 &center, float32 radius, const b2Vec2 &axis, const b2Color &color);
+    void DrawSegment(const b2Vec2 &p1, const b2Vec2 &p2, const b2Color &color);
+    void DrawTransform(const b2Transform &xf);
+    void DrawPoint(const b2Vec2 &p, float32 size, const b2Color &color);
+protected:
+    enum {CircleSegments = 16};
+    void line(const b2Vec2 &a, const b2Vec2 &b, const b2Color &color);
+    void triangle(const b2Vec2 &a, const b2Vec2 &b, const b2Vec2 &c, const b2Color &color);
+    static b2Vec2 onCircle(const b2Vec2 &center, float32 radius, int i);
+};
+
+// Definitions below
+
+inline void DebugDraw::line(const b2Vec2 &a, const b2Vec2 &b, const b2Color &color) {
+    vec4 c(color.r, color.g, color.b, color.a);
+    DebugVertex va = {vec2(a.x, a.y), c}, vb = {vec2(b.x, b.y), c};
+    target->lines.push_back(va);
+    target->lines.push_back(vb);
+}
+
+inline void DebugDraw::triangle(const b2Vec2 &a, const b2Vec2 &b, const b2Vec2 &c,
+                                const b2Color &color) {
+    vec4 col(color.r, color.g, color.b, color.a);
+    DebugVertex va = {vec2(a.x, a.y), col}, vb = {vec2(b.x, b.y), col},
+        vc = {vec2(c.x, c.y), col};
+    target->triangles.push_back(va);
+    target->triangles.push_back(vb);
+    target->triangles.push_back(vc);
+}
+
+inline b2Vec2 DebugDraw::onCircle(const b2Vec2 &center, float32 radius, int i) {
+    float32 t = 2*b2_pi*i/CircleSegments;
+    return center + radius*b2Vec2(std::cos(t), std::sin(t));
+}
+
+inline void DebugDraw::DrawPolygon(const b2Vec2 *vertices, int32 vertexCount,
+                                   const b2Color &color) {
+    for (int i = 0; i < vertexCount; i++)
+        line(vertices[i], vertices[(i+1) % vertexCount], color);
+}
+
+// Filled at half opacity with a solid outline, like the testbed.
+inline void DebugDraw::DrawSolidPolygon(const b2Vec2 *vertices, int32 vertexCount,
+                                        const b2Color &color) {
+    b2Color fill(0.5f*color.r, 0.5f*color.g, 0.5f*color.b, 0.5f);
+    for (int i = 1; i < vertexCount-1; i++)
+        triangle(vertices[0], vertices[i], vertices[i+1], fill);
+    DrawPolygon(vertices, vertexCount, color);
+}
+
+inline void DebugDraw::DrawCircle(const b2Vec2 &center, float32 radius, const b2Color &color) {
+    for (int i = 0; i < CircleSegments; i++)
+        line(onCircle(center, radius, i), onCircle(center, radius, i+1), color);
+}
+
+inline void DebugDraw::DrawSolidCircle(const b2Vec2 &center, float32 radius, const b2Vec2 &axis,
+                                       const b2Color &color) {
+    b2Color fill(0.5f*color.r, 0.5f*color.g, 0.5f*color.b, 0.5f);
+    for (int i = 0; i < CircleSegments; i++)
+        triangle(center, onCircle(center, radius, i), onCircle(center, radius, i+1), fill);
+    DrawCircle(center, radius, color);
+    line(center, center + radius*axis, color);
+}
+
+inline void DebugDraw::DrawSegment(const b2Vec2 &p1, const b2Vec2 &p2, const b2Color &color) {
+    line(p1, p2, color);
+}
+
+inline void DebugDraw::DrawTransform(const b2Transform &xf) {
+    const float32 axisScale = 0.4f;
+    line(xf.p, xf.p + axisScale*xf.q.GetXAxis(), b2Color(1, 0, 0));
+    line(xf.p, xf.p + axisScale*xf.q.GetYAxis(), b2Color(0, 1, 0));
+}
+
+// size is in pixels, as in the testbed.
+inline void DebugDraw::DrawPoint(const b2Vec2 &p, float32 size, const b2Color &color) {
+    float32 h = 0.5f*size*pixelSize;
+    b2Vec2 a = p + b2Vec2(-h, -h), b = p + b2Vec2(h, -h),
+        c = p + b2Vec2(h, h), d = p + b2Vec2(-h, h);
+    triangle(a, b, c, color);
+    triangle(a, c, d, color);
+}
+
+#endif
@@ -2,42 +2,92 @@
 #define DRAW_HPP
 
 #include "config.hpp"
+#include "debugdraw.hpp"
 #include "engine.hpp"
 #include "mesh.hpp"
 #include "shader.hpp"
+#include <cstddef>
+#include <cstring>
 #include <vector>
 #include <glm/glm.hpp>
 using glm::vec2;
 
+// Per-instance data for batched circles and boxes. The transform is
+// applied in instanced2d.vert.
+struct Instance2D {
+    vec2 position;
+    float angle;
+    vec2 size;
+    vec3 color;
+};
+
 class Draw {
 public:
     Engine *engine;
-    ShaderProgram shader;
-    Mesh2D arrowMesh, circleMesh, boxMesh, polylineMesh;
-    int maxVerts;
+    ShaderProgram shader, instancedShader, debugShader;
+    // Handles into the shaders, looked up once.
+    ShaderUniform<mat4> modelMatrixUniform;
+    ShaderUniform<vec3> colorUniform;
+    ShaderAttribute vertex, instanceVertex, instancePosition, instanceAngle,
+        instanceSize, instanceColor, debugVertex, debugColor;
+    // The engine's projection and modelview matrices, shared by both
+    // shaders through the Camera uniform block and re-sent only when the
+    // engine's change.
+    enum {CameraBinding = 0};
+    UniformBuffer cameraBuffer;
+    mat4 camera[2];
+    Mesh2D arrowMesh, circleMesh, boxMesh;
+    // Every static polyline packed into one mesh, see setStaticPolylines.
+    Mesh2D staticPolylineMesh;
+    std::vector<Instance2D> circleInstances, boxInstances;
     Draw() {}
     Draw(Engine *engine);
     void mesh(mat4 transform, Mesh2D &mesh, vec3 color, int nElements=-1);
     void circle(mat4 transform, vec2 center, float radius, vec3 color);
     void box(mat4 transform, vec2 center, vec2 size, vec3 color);
     void polyline(mat4 transform, std::vector<vec2> vertices, vec3 color);
+    // retained polylines; uploaded once, then drawn with a single call
+    void setStaticPolylines(const std::vector<std::vector<vec2> > &polylines);
+    void staticPolylines(mat4 transform, vec3 color);
     void axes(mat4 transform, float size);
+    // batched drawing; nothing is drawn until flush()
+    void batchCircle(vec2 center, float angle, float radius, vec3 color);
+    void batchBox(vec2 center, float angle, vec2 size, vec3 color);
+    void flush();
+    // Box2D debug geometry; one call for the triangles, one for the lines
+    void debug(const DebugGeometry &geometry);
+protected:
+    void updateCamera();
+    void instances(Mesh2D &mesh, int base, int count);
 };
 
 inline Draw::Draw(Engine *engine) {
     this->engine = engine;
     shader = ShaderProgram(Config::shaderVert, Config::shaderFrag);
+    instancedShader = ShaderProgram(Config::instancedVert, Config::instancedFrag);
+    modelMatrixUniform = shader.uniform<mat4>("modelMatrix");
+    colorUniform = shader.uniform<vec3>("color");
+    vertex = shader.attribute("vertex");
+    instanceVertex = instancedShader.attribute("vertex");
+    instancePosition = instancedShader.attribute("instancePosition");
+    instanceAngle = instancedShader.attribute("instanceAngle");
+    instanceSize = instancedShader.attribute("instanceSize");
+    instanceColor = instancedShader.attribute("instanceColor");
+    debugShader = ShaderProgram(Config::debugVert, Config::debugFrag);
+    debugVertex = debugShader.attribute("vertex");
+    debugColor = debugShader.attribute("vertexColor");
+    shader.setUniformBlock("Camera", CameraBinding);
+    instancedShader.setUniformBlock("Camera", CameraBinding);
+    debugShader.setUniformBlock("Camera", CameraBinding);
+    cameraBuffer = engine->allocateUniformBuffer(sizeof(camera));
+    engine->copyUniformData(cameraBuffer, camera, sizeof(camera));
+    engine->bindUniformBuffer(cameraBuffer, CameraBinding);
     circleMesh.makeCircle(vec2(0,0), 1);
     circleMesh.createGPUData(engine);
     boxMesh.makeBox(vec2(-0.5,-0.5), vec2(0.5,0.5));
     boxMesh.createGPUData(engine);
-    maxVerts = 100;
-    polylineMesh.vertices.resize(maxVerts);
-    
-    for (int i = 0; i < maxVerts-1; i++)
-        polylineMesh.edges.push_back(ivec2(i,i+1));
-    
-    polylineMesh.createGPUData(engine);
+    staticPolylineMesh.vertexBuffer = engine->allocateVertexBuffer(0);
+    staticPolylineMesh.indexBuffer = engine->allocateElementBuffer(0);
     arrowMesh.vertices.push_back(vec2(0,0));
     arrowMesh.vertices.push_back(vec2(1,0));
     arrowMesh.vertices.push_back(vec2(0.7,0.1));
@@ -48,12 +98,23 @@ inline Draw::Draw(Engine *engine) {
     arrowMesh.createGPUData(engine);
 }
 
+// Uploads the engine's current matrices if they differ from the last
+// ones sent.
+inline void Draw::updateCamera() {
+    mat4 current[2] = {engine->getMatrix(GL_PROJECTION), engine->getMatrix(GL_MODELVIEW)};
+    if (memcmp(current, camera, sizeof(camera)) == 0)
+        return;
+    camera[0] = current[0];
+    camera[1] = current[1];
+    engine->copyUniformData(cameraBuffer, camera, sizeof(camera));
+}
+
 inline void Draw::mesh(mat4 transform, Mesh2D &mesh, vec3 color, int nElements) {
+    updateCamera();
     shader.enable();
-    shader.setUniform("modelViewMatrix", engine->getMatrix(GL_MODELVIEW)*transform);
-    shader.setUniform("projectionMatrix", engine->getMatrix(GL_PROJECTION));
-    shader.setUniform("color", color);
-    shader.setAttribute("vertex", mesh.vertexBuffer, 2, GL_FLOAT);
+    shader.setUniform(modelMatrixUniform, transform);
+    shader.setUniform(colorUniform, color);
+    shader.setAttribute(vertex, mesh.vertexBuffer, 2, GL_FLOAT);
     
     if (nElements < 0)
         nElements = mesh.edges.size();
@@ -74,17 +135,118 @@ inline void Draw::box(mat4 transform, vec2 center, vec2 size, vec3 color) {
     mesh(transform, boxMesh, color);
 }
 
+// Writes the vertices to the engine's stream buffer and draws them as one
+// line strip, however long.
 inline void Draw::polyline(mat4 transform, std::vector<vec2> vertices, vec3 color) {
-    for (int i = 0; i < vertices.size(); i += maxVerts-1) {
-        int start = i, end = i + maxVerts;
-	
-        if (end > vertices.size())
-            end = vertices.size();
-	
-        engine->copyVertexData(polylineMesh.vertexBuffer,
-                               &vertices[start], (end-start)*sizeof(vec2));
-        mesh(transform, polylineMesh, color, end-start-1);
+    if (vertices.size() < 2)
+        return;
+    StreamBuffer &stream = engine->streamBuffer;
+    int offset = stream.write(&vertices[0], vertices.size()*sizeof(vec2));
+    updateCamera();
+    shader.enable();
+    shader.setUniform(modelMatrixUniform, transform);
+    shader.setUniform(colorUniform, color);
+    shader.setAttribute(vertex, stream.buffer, 2, GL_FLOAT);
+    engine->drawArrays(GL_LINE_STRIP, offset/sizeof(vec2), vertices.size());
+    shader.disable();
+}
+
+// Replaces the retained polylines. Call only when they change; the
+// vertices of all of them go into one buffer, with an edge between each
+// pair of consecutive vertices of the same polyline.
+inline void Draw::setStaticPolylines(const std::vector<std::vector<vec2> > &polylines) {
+    Mesh2D &m = staticPolylineMesh;
+    m.vertices.clear();
+    m.edges.clear();
+    for (int p = 0; p < polylines.size(); p++) {
+        int first = m.vertices.size();
+        m.vertices.insert(m.vertices.end(), polylines[p].begin(), polylines[p].end());
+        for (int i = first+1; i < m.vertices.size(); i++)
+            m.edges.push_back(ivec2(i-1,i));
+    }
+    if (m.edges.empty())
+        return;
+    engine->replaceVertexData(m.vertexBuffer, &m.vertices[0], m.vertices.size()*sizeof(vec2));
+    engine->replaceElementData(m.indexBuffer, &m.edges[0], m.edges.size()*sizeof(ivec2));
+}
+
+inline void Draw::staticPolylines(mat4 transform, vec3 color) {
+    if (!staticPolylineMesh.edges.empty())
+        mesh(transform, staticPolylineMesh, color);
+}
+
+inline void Draw::batchCircle(vec2 center, float angle, float radius, vec3 color) {
+    Instance2D instance = {center, angle, vec2(radius,radius), color};
+    circleInstances.push_back(instance);
+}
+
+inline void Draw::batchBox(vec2 center, float angle, vec2 size, vec3 color) {
+    Instance2D instance = {center, angle, size, color};
+    boxInstances.push_back(instance);
+}
+
+// Writes all batched instances to the stream buffer, circles first, and
+// draws each mesh type with a single instanced call.
+inline void Draw::flush() {
+    int nCircles = circleInstances.size(), nBoxes = boxInstances.size();
+    if (nCircles + nBoxes == 0)
+        return;
+    circleInstances.insert(circleInstances.end(), boxInstances.begin(), boxInstances.end());
+    int offset = engine->streamBuffer.write(&circleInstances[0],
+                                            circleInstances.size()*sizeof(Instance2D));
+    updateCamera();
+    instancedShader.enable();
+    if (nCircles > 0)
+        instances(circleMesh, offset, nCircles);
+    if (nBoxes > 0)
+        instances(boxMesh, offset + nCircles*sizeof(Instance2D), nBoxes);
+    instancedShader.disable();
+    circleInstances.clear();
+    boxInstances.clear();
+}
+
+// base is the byte offset of the first instance in the stream buffer.
+inline void Draw::instances(Mesh2D &mesh, int base, int count) {
+    VertexBuffer instanceBuffer = engine->streamBuffer.buffer;
+    int stride = sizeof(Instance2D);
+    instancedShader.setAttribute(instanceVertex, mesh.vertexBuffer, 2, GL_FLOAT);
+    instancedShader.setInstanceAttribute(instancePosition, instanceBuffer, 2, GL_FLOAT,
+                                         stride, base + offsetof(Instance2D, position));
+    instancedShader.setInstanceAttribute(instanceAngle, instanceBuffer, 1, GL_FLOAT,
+                                         stride, base + offsetof(Instance2D, angle));
+    instancedShader.setInstanceAttribute(instanceSize, instanceBuffer, 2, GL_FLOAT,
+                                         stride, base + offsetof(Instance2D, size));
+    instancedShader.setInstanceAttribute(instanceColor, instanceBuffer, 3, GL_FLOAT,
+                                         stride, base + offsetof(Instance2D, color));
+    engine->drawElementsInstanced(GL_LINES, mesh.indexBuffer, mesh.edges.size()*2, count);
+}
+
+// The fills are translucent, so the triangles are blended and drawn
+// first, under the outlines.
+inline void Draw::debug(const DebugGeometry &geometry) {
+    if (geometry.lines.empty() && geometry.triangles.empty())
+        return;
+    StreamBuffer &stream = engine->streamBuffer;
+    int stride = sizeof(DebugVertex);
+    updateCamera();
+    debugShader.enable();
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    const std::vector<DebugVertex> *parts[] = {&geometry.triangles, &geometry.lines};
+    GLenum modes[] = {GL_TRIANGLES, GL_LINES};
+    for (int i = 0; i < 2; i++) {
+        const std::vector<DebugVertex> &v = *parts[i];
+        if (v.empty())
+            continue;
+        int offset = stream.write(&v[0], v.size()*stride);
+        debugShader.setAttribute(debugVertex, stream.buffer, 2, GL_FLOAT,
+                                 stride, offset + offsetof(DebugVertex, position));
+        debugShader.setAttribute(debugColor, stream.buffer, 4, GL_FLOAT,
+                                 stride, offset + offsetof(DebugVertex, color));
+        engine->drawArrays(modes[i], 0, v.size());
     }
+    glDisable(GL_BLEND);
+    debugShader.disable();
 }
 
 inline void Draw::axes(mat4 transform, float size) {
@@ -2,10 +2,14 @@
 #define ENGINE_HPP
 
 #include "graphics.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 #include <glm/glm.hpp>
 
@@ -13,6 +17,7 @@ using glm::mat4;
 
 typedef GLuint VertexBuffer;
 typedef GLuint ElementBuffer;
+typedef GLuint UniformBuffer;
 typedef GLuint Texture;
 
 struct Framebuffer {
@@ -22,19 +27,69 @@ struct Framebuffer {
     Texture depthAndStencilBuffer;
 };
 
+// Timings of the last Capacity frames in nanoseconds, kept in a ring
+// buffer. Each frame is split into update (from the end of the last wait
+// to endUpdate()) and render (from there to the next wait). A frame
+// misses its deadline if update and render run past the scheduled start
+// of the next frame.
+class FrameTimes {
+public:
+    enum {Capacity = 256};
+    enum Phase {Frame, Update, Render, PhaseCount};
+    struct Summary {
+        double min, avg, p99; // milliseconds
+    };
+    FrameTimes(): count(0), next(0), missed(0) {}
+    void add(Uint64 frame, Uint64 update, Uint64 render, bool missedDeadline);
+    Summary summary(Phase phase) const;
+    int size() const { return count; }
+    int missedDeadlines() const { return missed; }
+    void clear();
+protected:
+    Uint64 times[PhaseCount][Capacity];
+    int count, next, missed;
+};
+
+// Vertex buffer for data that is written once and drawn once per frame.
+// It is split into FrameCount regions used in turn, one per frame, and
+// each region gets a fence when its frame ends. A region is only written
+// again after its fence has passed, so writes are unsynchronized maps
+// that never stall on or race with a pending draw. Frames that need more
+// than a region grow all of them, orphaning the old storage.
+class StreamBuffer {
+public:
+    enum {FrameCount = 3, Alignment = 16};
+    VertexBuffer buffer;
+    StreamBuffer(): buffer(0), regionBytes(0), frame(0), offset(0) {}
+    void create(int bytesPerFrame);
+    void destroy();
+    int write(const void *data, int bytes);
+    void endFrame();
+protected:
+    int regionBytes, frame, offset;
+    GLsync fences[FrameCount];
+    void grow(int bytes);
+};
+
 class Engine {
 public:
 
     static void errorMessage(std::string message);
     static void dieIfOpenGLError();
     
-    Engine();
+    Engine(Uint32 subsystems=SDL_INIT_VIDEO);
     ~Engine();
     SDL_Window* createWindow(std::string title, int width, int height);
     void destroyWindow(SDL_Window*);
     bool shouldQuit();
     void handleInput();
     void waitForNextFrame(float secondsPerFrame);
+    void endUpdate();
+    const FrameTimes& frameTimes() const;
+
+    // monotonic clock
+    static Uint64 nanoseconds();
+    static void sleepUntil(Uint64 deadline);
 
     // input state
     bool isKeyDown(int scancode);
@@ -49,10 +104,12 @@ public:
     virtual void onMouseMotion(SDL_MouseMotionEvent&) {}
     virtual void onMouseButtonDown(SDL_MouseButtonEvent&) {}
     virtual void onMouseButtonUp(SDL_MouseButtonEvent&) {}
+    virtual void onMouseWheel(SDL_MouseWheelEvent&) {}
 
     // vertex and element buffers
     VertexBuffer allocateVertexBuffer(int bytes);
     void copyVertexData(VertexBuffer buffer, void *data, int bytes);
+    void replaceVertexData(VertexBuffer buffer, void *data, int bytes);
     void setVertexArray(VertexBuffer buffer);
     void setColorArray(VertexBuffer buffer);
     void setNormalArray(VertexBuffer buffer);
@@ -61,9 +118,15 @@ public:
     void unsetColorArray();
     void unsetNormalArray();
     void unsetTexCoordArray();
+    void drawArrays(GLenum mode, int first, int count);
     ElementBuffer allocateElementBuffer(int bytes);
     void copyElementData(ElementBuffer buffer, void *data, int bytes);
+    void replaceElementData(ElementBuffer buffer, void *data, int bytes);
     void drawElements(GLenum mode, ElementBuffer buffer, int count);
+    void drawElementsInstanced(GLenum mode, ElementBuffer buffer, int count, int instances);
+    UniformBuffer allocateUniformBuffer(int bytes);
+    void copyUniformData(UniformBuffer buffer, void *data, int bytes);
+    void bindUniformBuffer(UniformBuffer buffer, int binding);
     // convenience functions
     template <typename T> VertexBuffer allocateVertexBuffer(std::vector<T> &data);
     template <typename T> ElementBuffer allocateElementBuffer(std::vector<T> &data);
@@ -87,9 +150,16 @@ public:
     void setFramebuffer(Framebuffer framebuffer);
     void unsetFramebuffer(SDL_Window *window);
 
+    // per-frame vertex data; created and destroyed with the window,
+    // fenced by waitForNextFrame
+    StreamBuffer streamBuffer;
+
 protected:
     bool userQuit;
-    int lastFrameTime;
+    // Scheduled start of the next frame, and when the current frame
+    // started and finished its update, all from nanoseconds().
+    Uint64 nextFrameTime, frameStartTime, updateEndTime;
+    FrameTimes times;
     GLenum matMode;
     std::vector<mat4> modelViewStack;
     std::vector<mat4> projectionStack;
@@ -100,12 +170,12 @@ protected:
 
 // Definitions below
 
-inline Engine::Engine() {
-    int status = SDL_Init(SDL_INIT_VIDEO);
+inline Engine::Engine(Uint32 subsystems) {
+    int status = SDL_Init(subsystems);
     if (status < 0)
         dieWithSDLError("Failed to initialize SDL");
     userQuit = false;
-    lastFrameTime = 0;
+    nextFrameTime = frameStartTime = updateEndTime = 0;
     modelViewStack.push_back(mat4());
     projectionStack.push_back(mat4());
 }
@@ -121,7 +191,7 @@ inline void Engine::dieWithSDLError(std::string message) {
 
 inline SDL_Window* Engine::createWindow(std::string title, int width, int height) {
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
     SDL_Window *window =
         SDL_CreateWindow(title.c_str(),
@@ -139,11 +209,13 @@ inline SDL_Window* Engine::createWindow(std::string title, int width, int height
     glGetError();
 #endif
     glEnable(GL_DEPTH_TEST);
+    streamBuffer.create(256*1024);
     dieIfOpenGLError();
     return window;
 }
 
 inline void Engine::destroyWindow(SDL_Window *window) {
+    streamBuffer.destroy();
     SDL_DestroyWindow(window);
 }
 
@@ -151,13 +223,17 @@ inline void Engine::errorMessage(std::string message){
 	SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Error", message.c_str(), NULL);
 }
 
+// glGetError waits for the driver to catch up, so this only checks in
+// debug builds; with NDEBUG defined it does nothing.
 inline void Engine::dieIfOpenGLError() {
+#ifndef NDEBUG
     GLenum error = glGetError();
     if (error != GL_NO_ERROR) {
         errorMessage(std::string("OpenGL error: ") + (char*)(gluErrorString(error)));
         abort();
         exit(EXIT_FAILURE);
     }
+#endif
 }
 
 inline void Engine::handleInput() {
@@ -182,6 +258,9 @@ inline void Engine::handleInput() {
         case SDL_MOUSEBUTTONUP:
             onMouseButtonUp(event.button);
             break;
+        case SDL_MOUSEWHEEL:
+            onMouseWheel(event.wheel);
+            break;
         }
     }
 }
@@ -190,13 +269,166 @@ inline bool Engine::shouldQuit() {
     return userQuit;
 }
 
+inline void FrameTimes::add(Uint64 frame, Uint64 update, Uint64 render, bool missedDeadline) {
+    times[Frame][next] = frame;
+    times[Update][next] = update;
+    times[Render][next] = render;
+    next = (next + 1) % Capacity;
+    count = std::min(count + 1, (int)Capacity);
+    if (missedDeadline)
+        missed++;
+}
+
+inline FrameTimes::Summary FrameTimes::summary(Phase phase) const {
+    Summary s = {0, 0, 0};
+    if (count == 0)
+        return s;
+    Uint64 sorted[Capacity];
+    std::copy(times[phase], times[phase] + count, sorted);
+    int p99 = (count*99 - 1)/100;
+    std::nth_element(sorted, sorted + p99, sorted + count);
+    Uint64 total = 0, least = sorted[0];
+    for (int i = 0; i < count; i++) {
+        total += sorted[i];
+        least = std::min(least, sorted[i]);
+    }
+    s.min = least*1e-6;
+    s.avg = total*1e-6/count;
+    s.p99 = sorted[p99]*1e-6;
+    return s;
+}
+
+inline void FrameTimes::clear() {
+    count = next = missed = 0;
+}
+
+inline void StreamBuffer::create(int bytesPerFrame) {
+    glGenBuffers(1, &buffer);
+    for (int i = 0; i < FrameCount; i++)
+        fences[i] = 0;
+    grow(bytesPerFrame);
+}
+
+// Deletes the buffer and any pending fences. Needs the context the
+// buffer was created in.
+inline void StreamBuffer::destroy() {
+    if (buffer == 0)
+        return;
+    for (int i = 0; i < FrameCount; i++) {
+        if (fences[i] != 0)
+            glDeleteSync(fences[i]);
+        fences[i] = 0;
+    }
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+    regionBytes = frame = offset = 0;
+}
+
+// Copies data into this frame's region and returns its byte offset in
+// buffer, a multiple of Alignment.
+inline int StreamBuffer::write(const void *data, int bytes) {
+    int size = (bytes + Alignment-1) & ~(Alignment-1);
+    if (offset + size > regionBytes)
+        grow(std::max(2*regionBytes, size));
+    int start = frame*regionBytes + offset;
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    void *dst = glMapBufferRange(GL_ARRAY_BUFFER, start, bytes,
+                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+                                 GL_MAP_UNSYNCHRONIZED_BIT);
+    memcpy(dst, data, bytes);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    offset += size;
+    return start;
+}
+
+// Fences the region just drawn from and moves to the next one, waiting
+// for the GPU if it is still reading that one from FrameCount frames ago.
+inline void StreamBuffer::endFrame() {
+    if (buffer == 0)
+        return;
+    if (fences[frame] != 0)
+        glDeleteSync(fences[frame]);
+    fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    frame = (frame + 1) % FrameCount;
+    offset = 0;
+    if (fences[frame] != 0) {
+        glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        glDeleteSync(fences[frame]);
+        fences[frame] = 0;
+    }
+}
+
+// Fresh storage has no pending draws, so the fences can go. This frame
+// carries on at the start of region 0.
+inline void StreamBuffer::grow(int bytes) {
+    regionBytes = (bytes + Alignment-1) & ~(Alignment-1);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, FrameCount*regionBytes, NULL, GL_STREAM_DRAW);
+    for (int i = 0; i < FrameCount; i++) {
+        if (fences[i] != 0)
+            glDeleteSync(fences[i]);
+        fences[i] = 0;
+    }
+    frame = 0;
+    offset = 0;
+}
+
+inline Uint64 Engine::nanoseconds() {
+    using namespace std::chrono;
+    return duration_cast<std::chrono::nanoseconds>(
+        steady_clock::now().time_since_epoch()).count();
+}
+
+// The OS may oversleep by a scheduler tick or more, so this only sleeps
+// until shortly before the deadline and spins for the rest.
+inline void Engine::sleepUntil(Uint64 deadline) {
+    const Uint64 spinTime = 2000000;
+    for (;;) {
+        Uint64 now = nanoseconds();
+        if (now >= deadline)
+            return;
+        if (deadline - now > spinTime)
+            std::this_thread::sleep_for(std::chrono::nanoseconds(deadline - now - spinTime));
+        else
+            std::this_thread::yield();
+    }
+}
+
+// Frames are scheduled at fixed multiples of secondsPerFrame from the
+// first one, so waking up late doesn't push later frames back. After a
+// missed deadline the schedule restarts from now rather than rushing
+// through the frames it is behind.
 inline void Engine::waitForNextFrame(float secondsPerFrame) {
-    int millisPerFrame = (int)(1000*secondsPerFrame);
-    int now = SDL_GetTicks();
-    int nextFrameTime = lastFrameTime + millisPerFrame;
-    lastFrameTime = now;
-    if (nextFrameTime > now)
-        SDL_Delay(nextFrameTime - now);
+    streamBuffer.endFrame();
+    Uint64 period = (Uint64)(1e9*secondsPerFrame);
+    Uint64 now = nanoseconds();
+    if (frameStartTime == 0) {
+        frameStartTime = updateEndTime = now;
+        nextFrameTime = now;
+    }
+    if (updateEndTime < frameStartTime)
+        updateEndTime = frameStartTime;
+    Uint64 update = updateEndTime - frameStartTime;
+    Uint64 render = now - updateEndTime;
+    nextFrameTime += period;
+    bool missed = (now > nextFrameTime);
+    if (missed)
+        nextFrameTime = now;
+    else
+        sleepUntil(nextFrameTime);
+    Uint64 start = nanoseconds();
+    times.add(start - frameStartTime, update, render, missed);
+    frameStartTime = start;
+}
+
+// Marks the end of the update part of the frame; the rest until
+// waitForNextFrame counts as render time.
+inline void Engine::endUpdate() {
+    updateEndTime = nanoseconds();
+}
+
+inline const FrameTimes& Engine::frameTimes() const {
+    return times;
 }
 
 inline bool Engine::isKeyDown(int scancode) {
@@ -247,12 +479,27 @@ inline void Engine::copyVertexData(VertexBuffer buffer, void *data, int size) {
     dieIfOpenGLError();
 }
 
+// Replaces the whole contents of the buffer, resizing it if needed, for
+// data that will be drawn many times before it is replaced. The old
+// storage is orphaned so the driver doesn't wait on pending draws.
+inline void Engine::replaceVertexData(VertexBuffer buffer, void *data, int size) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+    dieIfOpenGLError();
+}
+
 inline void Engine::copyElementData(ElementBuffer buffer, void *data, int size) {
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
     glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, size, data);
     dieIfOpenGLError();
 }
 
+inline void Engine::replaceElementData(ElementBuffer buffer, void *data, int size) {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+    dieIfOpenGLError();
+}
+
 inline void Engine::setVertexArray(VertexBuffer buffer) {
     glEnableClientState(GL_VERTEX_ARRAY);
     glBindBuffer(GL_ARRAY_BUFFER, buffer);
@@ -307,6 +554,39 @@ inline void Engine::drawElements(GLenum mode, ElementBuffer buffer, int count) {
     dieIfOpenGLError();
 }
 
+inline void Engine::drawArrays(GLenum mode, int first, int count) {
+    glDrawArrays(mode, first, count);
+    dieIfOpenGLError();
+}
+
+inline void Engine::drawElementsInstanced(GLenum mode, ElementBuffer buffer, int count, int instances) {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+    glDrawElementsInstanced(mode, count, GL_UNSIGNED_INT, 0, instances);
+    dieIfOpenGLError();
+}
+
+inline UniformBuffer Engine::allocateUniformBuffer(int size) {
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+    dieIfOpenGLError();
+    return buffer;
+}
+
+inline void Engine::copyUniformData(UniformBuffer buffer, void *data, int size) {
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+    dieIfOpenGLError();
+}
+
+// Shaders read the blocks bound to binding (see
+// ShaderProgram::setUniformBlock) from buffer.
+inline void Engine::bindUniformBuffer(UniformBuffer buffer, int binding) {
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+    dieIfOpenGLError();
+}
+
 template <typename T>
 inline VertexBuffer Engine::allocateVertexBuffer(std::vector<T> &data) {
     int size = data.size()*sizeof(T);
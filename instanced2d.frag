@@ -0,0 +1,11 @@
+#version 330
+
+in vec3 vertexColor;
+
+out vec4 outColor;
+
+void main() {
+
+    outColor = vec4(vertexColor, 1);
+
+}
@@ -0,0 +1,27 @@
+#version 330
+
+// per-frame camera matrices, shared by all shaders
+layout(std140) uniform Camera {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+};
+
+in vec2 vertex;
+
+// per-instance attributes
+in vec2 instancePosition;
+in float instanceAngle;
+in vec2 instanceSize;
+in vec3 instanceColor;
+
+out vec3 vertexColor;
+
+void main() {
+
+    float c = cos(instanceAngle), s = sin(instanceAngle);
+    vec2 p = vertex*instanceSize;
+    p = vec2(c*p.x - s*p.y, s*p.x + c*p.y) + instancePosition;
+    gl_Position = projectionMatrix * viewMatrix * vec4(p,0,1);
+    vertexColor = instanceColor;
+
+}
@@ -3,10 +3,21 @@
 #include "config.hpp"
 #include "draw.hpp"
 #include "mesh.hpp"
+#include "profiler.hpp"
+#include "registry.hpp"
+#include "scene.hpp"
 #include "shapes.hpp"
+#include "snapshot.hpp"
 #include "uihelper.hpp"
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <thread>
 #include <vector>
 #include "./Box2D/Box2D.h"
 
@@ -16,6 +27,48 @@ using glm::vec3;
 using glm::vec4;
 using glm::mat4;
 
+// Finds the dynamic body under a point. The broad-phase query only returns
+// fixtures whose AABB overlaps the point; TestPoint then checks the actual
+// rotated shape. When shapes overlap the smallest one wins, so a small body
+// lying on a large one can still be grabbed.
+class PickCallback: public b2QueryCallback {
+public:
+    b2Vec2 point;
+    b2Fixture *fixture;
+    float area;
+
+    PickCallback(b2Vec2 point): point(point), fixture(NULL), area(0) {}
+
+    bool ReportFixture(b2Fixture *candidate) {
+        if (candidate->GetBody()->GetType() != b2_dynamicBody)
+            return true;
+        if (!candidate->TestPoint(point))
+            return true;
+        b2MassData massData;
+        candidate->GetShape()->ComputeMass(&massData, 1);
+        if (fixture == NULL || massData.mass < area) {
+            fixture = candidate;
+            area = massData.mass;
+        }
+        return true;
+    }
+};
+
+// Collects the registry indices of the circles and boxes whose fixtures
+// overlap the query box.
+class VisibleCallback: public b2QueryCallback {
+public:
+    const BodyRegistry *registry;
+    vector<int> indices;
+
+    bool ReportFixture(b2Fixture *fixture) {
+        int index = registry->indexOf(fixture->GetBody());
+        if (index >= 0)
+            indices.push_back(index);
+        return true;
+    }
+};
+
 class PencilPhysics: public Engine, UIMain {
 public:
 
@@ -26,31 +79,63 @@ public:
 	b2World *world;
 
     Polyline walls;
-    Circle redCircle;
-    Box whiteBox;
-    vector<Circle> circles;
-    vector<Box> boxes;
+    // The static red circle and white box, then every circle and box added.
+    BodyRegistry registry;
+    BodyId redCircle, whiteBox;
     vector<Polyline> polylines;
 
-	vector<b2Body*> bodies;
 	b2MouseJoint* mouseJoint;
 
     vec2 worldMin, worldMax;
-
-    PencilPhysics() {
+    bool headless;
+    // The camera's view as last sent by the UI, on the physics thread.
+    // Only bodies in or near it go into the snapshots.
+    vec2 viewMin, viewMax;
+    VisibleCallback visible;
+    // Records b2World::DrawDebugData into each snapshot when flags are on.
+    DebugDraw debugDraw;
+
+    // In run() the world is stepped on its own thread. The render thread
+    // only reads the snapshots it publishes, and UI actions reach the
+    // world through the command queue, applied between steps.
+    TripleBuffer<Snapshot> snapshots;
+    UICommandQueue commands;
+    std::atomic<bool> physicsRunning;
+    int polylineVersion, drawnPolylineVersion;
+
+    // Toggled with P or started by --profile; written to profilePath.
+    Profiler profiler;
+    std::string profilePath;
+    // Written with S and read back with L.
+    std::string scenePath;
+
+    // A headless instance never touches SDL video or OpenGL, so it can
+    // run on machines without a display.
+    PencilPhysics(bool headless=false):
+        Engine(headless ? 0 : SDL_INIT_VIDEO), window(NULL),
+        mouseJoint(NULL), headless(headless), physicsRunning(false),
+        polylineVersion(0), drawnPolylineVersion(-1), profilePath("profile.json"),
+        scenePath("scene.pps") {
 		world = new b2World(b2Vec2(0, -9.8));
+        world->SetDebugDraw(&debugDraw);
         worldMin = vec2(-8, 0);
         worldMax = vec2(8, 9);
-        window = createWindow("4611", 1280, 720);
-        camera = Camera2D(worldMin, worldMax);
-        uiHelper = UIHelper(this, worldMin, worldMax, 1280, 720);
-        draw = Draw(this);
+        viewMin = worldMin;
+        viewMax = worldMax;
+        visible.registry = &registry;
+        if (!headless) {
+            window = createWindow("4611", 1280, 720);
+            camera = Camera2D(worldMin, worldMax);
+            draw = Draw(this);
+        }
+        uiHelper = UIHelper(&commands, &camera, 1280, 720);
         // Initialize world
         initWorld();
     }
 
     ~PencilPhysics() {
-        SDL_DestroyWindow(window);
+        if (window != NULL)
+            destroyWindow(window);
     }
 
     void initWorld() {
@@ -79,15 +164,8 @@ public:
 		//fixtureDef.friction = 0.3f;
 		//body->CreateFixture(&fixtureDef);
 
-		
-		// Set up ground body
-		float height = 0.1;
-		b2BodyDef groundDef;
-		groundDef.position.Set(0, 0);
-		b2Body *groundBody = world->CreateBody(&groundDef);
-		b2PolygonShape groundShape;
-		groundShape.SetAsBox(16, 0.5);
-		groundBody->CreateFixture(&groundShape, 0.0f);
+
+        createStaticBodies();
 
         // Create walls
         vector<vec2> wallVerts;
@@ -98,62 +176,184 @@ public:
         walls = Polyline(wallVerts, world);
 
 		polylines.push_back(walls);
+		polylineVersion++;
+    }
+
+    // The bodies that clear() keeps: the ground, and the red circle and
+    // white box, which go into the empty registry first.
+    void createStaticBodies() {
+		// Set up ground body
+		b2BodyDef groundDef;
+		groundDef.position.Set(0, 0);
+		b2Body *groundBody = world->CreateBody(&groundDef);
+		b2PolygonShape groundShape;
+		groundShape.SetAsBox(16, 0.5);
+		groundBody->CreateFixture(&groundShape, 0.0f);
 
         // Create two static bodies
-        redCircle = Circle(vec2(-5,2), 0.5);
-        whiteBox = Box(vec2(5,2), vec2(0.9,0.9));
-
-		 //Set up rigid body
-		 //red circle
-		b2BodyDef red_body_def;
-		red_body_def.type = b2_staticBody;
-		red_body_def.position.Set(redCircle.center.x, redCircle.center.y);
-		red_body_def.linearVelocity.Set(0, 0);
-		red_body_def.angularVelocity = 0.1;
-		b2Body *red_circle_body = world->CreateBody(&red_body_def);
-
-		b2CircleShape b2_red;
-		b2_red.m_p.Set(0, 0);
-		b2_red.m_radius = redCircle.radius;
-
-		b2FixtureDef fixtureDef;
-		fixtureDef.shape = &b2_red;
-		fixtureDef.density = .2;
-		fixtureDef.friction = .4;
-		fixtureDef.restitution = .4;
-		red_circle_body->CreateFixture(&fixtureDef);
-
-		
-
-		// white rectangle
-		b2BodyDef white_rect_def;
-		white_rect_def.type = b2_staticBody;
-		white_rect_def.position.Set(whiteBox.center.x, whiteBox.center.y);
-		white_rect_def.linearVelocity.Set(0, 0);
-		white_rect_def.angularVelocity = 0.1;
-		b2Body *white_rect_body = world->CreateBody(&white_rect_def);
-
-		b2PolygonShape polygon;
-		polygon.SetAsBox(whiteBox.size.x/2, whiteBox.size.y/2);
-		b2FixtureDef fixtureDef_whitebox;
-		fixtureDef_whitebox.shape = &polygon;
-		fixtureDef_whitebox.density = .2;
-		fixtureDef_whitebox.friction = .4;
-		fixtureDef_whitebox.restitution = .4;
-		white_rect_body->CreateFixture(&fixtureDef_whitebox);
-
-		bodies.push_back(red_circle_body);
-		bodies.push_back(white_rect_body);
-    }
-
-    void run() {
-        float fps = 60, dt = 1/fps;
+		b2Body *red_circle_body = createCircleBody(world, vec2(-5,2), 0.5, b2_staticBody);
+		b2Body *white_rect_body = createBoxBody(world, vec2(5,2), vec2(0.9,0.9), b2_staticBody);
+		redCircle = registry.add(red_circle_body, CircleBody, vec2(0.5,0.5), vec3(1,0,0));
+		whiteBox = registry.add(white_rect_body, BoxBody, vec2(0.9,0.9), vec3(1,1,1));
+    }
+
+    // Renders on the calling thread while runPhysics steps the world on
+    // another, so frame time no longer includes step time. Each frame
+    // draws the latest snapshot, blended by how much real time has passed
+    // since the state it holds.
+    void run(float physicsHz, float renderFps, bool frameStats) {
+        Uint64 frequency = SDL_GetPerformanceFrequency();
+        publishSnapshot(SDL_GetPerformanceCounter(), 1/physicsHz, 0, 0);
+        physicsRunning = true;
+        std::thread physicsThread(&PencilPhysics::runPhysics, this, physicsHz);
+        int frames = 0;
         while (!shouldQuit()) {
-            handleInput();
+            {
+                ProfileScope scope(profiler, Profiler::RenderTrack, "handleInput");
+                handleInput();
+            }
+            bool fresh = snapshots.update();
+            const Snapshot &s = snapshots.readBuffer();
+            if (fresh && frameStats)
+                printf("substeps: %d  leftover: %.3f ms\n",
+                       s.subSteps, 1000*s.leftover);
+            endUpdate();
+            float elapsed = s.leftover + (float)(SDL_GetPerformanceCounter() - s.time)/frequency;
+            drawGraphics(s, min(elapsed/s.dt, 1.0f));
+            {
+                ProfileScope scope(profiler, Profiler::RenderTrack, "wait");
+                waitForNextFrame(1/renderFps);
+            }
+            if (frameStats && ++frames % FrameTimes::Capacity == 0) {
+                printFrameTimes();
+                printf("bodies drawn: %d  culled: %d\n", s.bodies.size(), s.culledBodies);
+            }
+        }
+        physicsRunning = false;
+        physicsThread.join();
+    }
+
+    // Prints min/avg/p99 of the frames in the ring buffer, and how many
+    // frames so far started late.
+    void printFrameTimes() {
+        const FrameTimes &t = frameTimes();
+        const char *names[] = {"frame", "update", "render"};
+        for (int i = 0; i < FrameTimes::PhaseCount; i++) {
+            FrameTimes::Summary s = t.summary((FrameTimes::Phase)i);
+            printf("%-7s min %7.3f  avg %7.3f  p99 %7.3f ms\n",
+                   names[i], s.min, s.avg, s.p99);
+        }
+        printf("missed deadlines: %d\n", t.missedDeadlines());
+    }
+
+    // Body of the physics thread. Physics advances in fixed steps of
+    // 1/physicsHz, as many as the real elapsed time calls for, so a slow
+    // step doesn't slow the simulation and the render rate can differ from
+    // the physics rate. At most maxSubSteps run at once; any further
+    // backlog is dropped so a long stall can't snowball. Between updates
+    // the thread sleeps until the next step is due.
+    void runPhysics(float physicsHz) {
+        const int maxSubSteps = 8;
+        float dt = 1/physicsHz;
+        float accumulator = 0;
+        Uint64 frequency = SDL_GetPerformanceFrequency();
+        Uint64 lastTime = SDL_GetPerformanceCounter();
+        while (physicsRunning) {
+            {
+                ProfileScope scope(profiler, Profiler::PhysicsTrack, "commands");
+                commands.apply(this);
+            }
+            Uint64 now = SDL_GetPerformanceCounter();
+            accumulator += (float)(now - lastTime)/frequency;
+            lastTime = now;
+            int subSteps = 0;
+            while (accumulator >= dt && subSteps < maxSubSteps) {
+                advanceState(dt);
+                accumulator -= dt;
+                subSteps++;
+            }
+            if (accumulator >= dt)
+                accumulator = fmod(accumulator, dt);
+            if (subSteps > 0) {
+                ProfileScope scope(profiler, Profiler::PhysicsTrack, "publishSnapshot");
+                publishSnapshot(now, dt, subSteps, accumulator);
+            } else {
+                ProfileScope scope(profiler, Profiler::PhysicsTrack, "wait");
+                SDL_Delay((Uint32)(1000*(dt - accumulator)));
+            }
+        }
+    }
+
+    // Copies the drawable state into the free snapshot slot and hands it to
+    // the render thread. Slots keep their vectors, so this doesn't allocate
+    // once the body count is stable.
+    void publishSnapshot(Uint64 time, float dt, int subSteps, float leftover) {
+        Snapshot &s = snapshots.writeBuffer();
+        s.time = time;
+        s.dt = dt;
+        s.subSteps = subSteps;
+        s.leftover = leftover;
+        // The render thread may have moved the camera a little since the
+        // view was sent, so cull against a slightly larger box.
+        vec2 margin = 0.1f*(viewMax - viewMin) + vec2(1,1);
+        b2AABB aabb;
+        aabb.lowerBound = b2Vec2(viewMin.x - margin.x, viewMin.y - margin.y);
+        aabb.upperBound = b2Vec2(viewMax.x + margin.x, viewMax.y + margin.y);
+        visible.indices.clear();
+        world->QueryAABB(&visible, aabb);
+        sort(visible.indices.begin(), visible.indices.end());
+        visible.indices.erase(unique(visible.indices.begin(), visible.indices.end()),
+                              visible.indices.end());
+        s.bodies.assign(registry.arrays, visible.indices);
+        s.culledBodies = registry.size() - s.bodies.size();
+        s.debug.clear();
+        if (debugDraw.GetFlags() != 0) {
+            debugDraw.target = &s.debug;
+            world->DrawDebugData();
+        }
+        if (s.polylineVersion != polylineVersion) {
+            s.polylines.resize(polylines.size());
+            for (int i = 0; i < polylines.size(); i++)
+                s.polylines[i] = polylines[i].vertices;
+            s.polylineVersion = polylineVersion;
+        }
+        snapshots.publish();
+    }
+
+    // Steps the world as fast as possible without input, rendering or
+    // frame pacing, then prints the throughput and the average
+    // b2Profile breakdown per step.
+    void runHeadless(int steps, float physicsHz) {
+        float dt = 1/physicsHz;
+        b2Profile total = {};
+        b2Timer timer;
+        for (int i = 0; i < steps; i++) {
             advanceState(dt);
-            drawGraphics();
-            waitForNextFrame(dt);
+            const b2Profile &p = world->GetProfile();
+            total.step += p.step;
+            total.collide += p.collide;
+            total.solve += p.solve;
+            total.solveInit += p.solveInit;
+            total.solveVelocity += p.solveVelocity;
+            total.solvePosition += p.solvePosition;
+            total.broadphase += p.broadphase;
+            total.solveTOI += p.solveTOI;
         }
+        float elapsed = timer.GetMilliseconds();
+        float n = (steps > 0) ? steps : 1;
+        printf("bodies: %d  contacts: %d  steps: %d\n",
+               world->GetBodyCount(), world->GetContactCount(), steps);
+        printf("elapsed: %.2f ms  steps/sec: %.1f\n",
+               elapsed, (elapsed > 0) ? 1000*steps/elapsed : 0.0f);
+        printf("average ms per step:\n");
+        printf("  step          %8.4f\n", total.step/n);
+        printf("  collide       %8.4f\n", total.collide/n);
+        printf("  solve         %8.4f\n", total.solve/n);
+        printf("  solveInit     %8.4f\n", total.solveInit/n);
+        printf("  solveVelocity %8.4f\n", total.solveVelocity/n);
+        printf("  solvePosition %8.4f\n", total.solvePosition/n);
+        printf("  broadphase    %8.4f\n", total.broadphase/n);
+        printf("  solveTOI      %8.4f\n", total.solveTOI/n);
     }
 
     vec2 randomVec2() {
@@ -162,28 +362,34 @@ public:
 
     void addCircle() {
         vec2 position = vec2(-5,7) + 0.5*randomVec2();
-        circles.push_back(Circle(position, 0.5, world));
+        b2Body *body = createCircleBody(world, position, 0.5);
+        registry.add(body, CircleBody, vec2(0.5,0.5), vec3(0,0,0));
     }
 
     void addBox() {
         vec2 position = vec2(-5,7) + 0.5*randomVec2();
-        boxes.push_back(Box(position, vec2(1.2,0.6), world));
+        b2Body *body = createBoxBody(world, position, vec2(1.2,0.6));
+        registry.add(body, BoxBody, vec2(1.2,0.6), vec3(0,0,0));
     }
 
     void addPolyline(vector<vec2> vertices) {
         polylines.push_back(Polyline(vertices, world));
+        polylineVersion++;
     }
 
     void clear() {
-        for (int i = 0; i < circles.size(); i++)
-            world->DestroyBody(circles[i].circle_body);
-        circles.clear();
-        for (int i = 0; i < boxes.size(); i++)
-			world->DestroyBody(boxes[i].rect_body);
-        boxes.clear();
-        for (int i = 0; i < polylines.size(); i++)
-			world->DestroyBody(polylines[i].chain_body);
+        // Empty the registry before the world frees its bodies. Walking
+        // backwards, removeAt never has to move an entry.
+        for (int i = registry.size()-1; i >= 0; i--)
+            registry.removeAt(i);
+        // One bulk reset of everything, the polylines' chain bodies and the
+        // mouse joint included, instead of a DestroyBody per body and a
+        // proxy removal per chain edge. Then the kept bodies are made again.
+        world->Clear();
+        mouseJoint = NULL;
         polylines.clear();
+        polylineVersion++;
+        createStaticBodies();
     }
 
     void onKeyDown(SDL_KeyboardEvent &e) {
@@ -201,23 +407,26 @@ public:
     void onMouseMotion(SDL_MouseMotionEvent &e) {
         uiHelper.onMouseMotion(e);
     }
+    void onMouseWheel(SDL_MouseWheelEvent &e) {
+        uiHelper.onMouseWheel(e);
+    }
+
+    void setView(vec2 viewMin, vec2 viewMax) {
+        this->viewMin = viewMin;
+        this->viewMax = viewMax;
+        debugDraw.pixelSize = (viewMax.x - viewMin.x)/1280;
+    }
+
+    void setDebugDrawFlags(int flags) {
+        debugDraw.SetFlags(flags);
+    }
 
     void advanceState(float dt) {
 
         // TODO: Step the Box2D world by dt.
+        Uint64 stepStart = Engine::nanoseconds();
 		world->Step(dt, 8, 3);
-
-		for (int i = 0; i < circles.size(); i++)
-		{
-			circles[i].center.x = circles[i].circle_body->GetPosition().x;
-			circles[i].center.y = circles[i].circle_body->GetPosition().y;
-		}
-
-		for (int i = 0; i < boxes.size(); i++)
-		{
-			boxes[i].center.x = boxes[i].rect_body->GetPosition().x;
-			boxes[i].center.y = boxes[i].rect_body->GetPosition().y;
-		}
+        profiler.addStep(stepStart, world->GetProfile());
 
 		//for (int i = 0; i < polylines.size(); i++)
 		//{
@@ -225,16 +434,84 @@ public:
 		//	polylines[i].center.y = polylines[i].chain_body->GetPosition().y;
 		//}
 
+        ProfileScope scope(profiler, Profiler::PhysicsTrack, "sync");
+		registry.sync();
+    }
 
-		redCircle.center.x = bodies[0]->GetPosition().x;
-		redCircle.center.y = bodies[0]->GetPosition().y;
+    // Starts recording, or stops and writes the file. Runs on the physics
+    // thread when it comes through the command queue.
+    void toggleProfiling() {
+        if (!profiler.isRecording()) {
+            profiler.start(profilePath);
+            printf("profiling to %s\n", profilePath.c_str());
+        } else if (profiler.stop()) {
+            printf("wrote %s\n", profiler.outputPath().c_str());
+        } else {
+            fprintf(stderr, "Failed to write %s\n", profiler.outputPath().c_str());
+        }
+    }
 
-		whiteBox.center.x = bodies[1]->GetPosition().x;
-		whiteBox.center.y = bodies[1]->GetPosition().y;
+    // Writes every body and polyline that clear() doesn't make again, with
+    // its current pose and velocities, to scenePath. The static red circle
+    // and white box are part of every world, so they aren't saved.
+    void saveScene() {
+        SceneWriter scene;
+        for (int i = 0; i < registry.size(); i++) {
+            const b2Body *body = registry.bodies[i];
+            if (body->GetType() == b2_dynamicBody)
+                scene.addBody(body, (BodyKind)registry.arrays.kinds[i],
+                              registry.arrays.sizes[i], registry.arrays.colors[i]);
+        }
+        for (int i = 0; i < polylines.size(); i++)
+            scene.addPolyline(polylines[i].vertices);
+        if (scene.write(scenePath))
+            printf("wrote %s\n", scenePath.c_str());
+        else
+            fprintf(stderr, "Failed to write %s\n", scenePath.c_str());
+    }
 
+    // Replaces the current scene with the one in scenePath. Each body is
+    // created directly in its saved state from the mapped file, and the
+    // broad-phase tree is built once over all of them. Contacts are found
+    // again on the next step, so the first step after loading has no warm
+    // starting.
+    void loadScene() {
+        Uint64 start = Engine::nanoseconds();
+        SceneReader scene;
+        if (!scene.open(scenePath)) {
+            fprintf(stderr, "Failed to load %s\n", scenePath.c_str());
+            return;
+        }
+        clear();
+        registry.reserve(registry.size() + scene.bodyCount);
+        world->BeginBulkCreate();
+        for (int i = 0; i < scene.bodyCount; i++) {
+            const SceneBody &b = scene.bodies[i];
+            b2BodyDef def = scene.bodyDef(i);
+            b2Body *body;
+            if (b.kind == CircleBody)
+                body = createCircleBody(world, def, b.size.x);
+            else
+                body = createBoxBody(world, def, b.size);
+            registry.add(body, (b.kind == CircleBody) ? CircleBody : BoxBody, b.size, b.color);
+        }
+        const vec2 *vertices = scene.vertices;
+        for (int i = 0; i < scene.polylineCount; i++) {
+            int n = scene.polylineSizes[i];
+            polylines.push_back(Polyline(vector<vec2>(vertices, vertices + n), world));
+            vertices += n;
+        }
+        world->EndBulkCreate();
+        polylineVersion++;
+        printf("loaded %d bodies and %d polylines from %s in %.2f ms\n",
+               scene.bodyCount, scene.polylineCount, scenePath.c_str(),
+               (Engine::nanoseconds() - start)*1e-6);
     }
 
-    void drawGraphics() {
+    // alpha is how far rendering is between the last two physics steps.
+    // Only the snapshot is read, never the world or the shapes.
+    void drawGraphics(const Snapshot &s, float alpha) {
+        ProfileScope scope(profiler, Profiler::RenderTrack, "drawGraphics");
         // Light gray background
         glClearColor(0.8,0.8,0.8, 1);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -251,18 +528,30 @@ public:
         // TODO: Modify these draw calls to draw the bodies with the
         // correct positions and angles.
 
-        // Draw red circle and white box.
-        draw.circle(mat4(), redCircle.center, redCircle.radius, vec3(1,0,0));
-        draw.box(mat4(), whiteBox.center, whiteBox.size, vec3(1,1,1));
-        // Draw all the other circles, boxes, and polylines
-        for (int i = 0; i < circles.size(); i++)
-            draw.circle(circles[i].getTransformation(), vec2(0, 0), circles[i].radius, vec3(0,0,0));
-        for (int i = 0; i < boxes.size(); i++)
-            draw.box(boxes[i].getTransformation(), vec2(0, 0), boxes[i].size, vec3(0,0,0));
-        for (int i = 0; i < polylines.size(); i++)
-            draw.polyline(mat4(), polylines[i].vertices, vec3(0,0,0));
+        // Draw the circles and boxes, including the red circle and white
+        // box, then the polylines. Circles and boxes are batched into one
+        // instanced draw per mesh.
+        const BodyArrays &b = s.bodies;
+        for (int i = 0; i < b.size(); i++) {
+            vec2 position = glm::mix(b.previousPositions[i], b.positions[i], alpha);
+            float angle = glm::mix(b.previousAngles[i], b.angles[i], alpha);
+            if (b.kinds[i] == CircleBody)
+                draw.batchCircle(position, angle, b.sizes[i].x, b.colors[i]);
+            else
+                draw.batchBox(position, angle, b.sizes[i], b.colors[i]);
+        }
+        draw.flush();
+        // Finished polylines never move, so they are only uploaded when
+        // one is added or they are cleared.
+        if (s.polylineVersion != drawnPolylineVersion) {
+            draw.setStaticPolylines(s.polylines);
+            drawnPolylineVersion = s.polylineVersion;
+        }
+        draw.staticPolylines(mat4(), vec3(0,0,0));
+        draw.debug(s.debug);
 
         // Finish
+        ProfileScope swapScope(profiler, Profiler::RenderTrack, "SwapWindow");
         SDL_GL_SwapWindow(window);
     }
 
@@ -281,25 +570,20 @@ public:
         //   frequencyHz: 2
         //   dampingRatio: 0.5
 
-		b2Body* attachment = NULL;
-		for (int i = 0; i < circles.size(); i++)
-		{
-			if (circles[i].contains(worldPoint))
-				attachment = circles[i].circle_body;
-		}
-
-		for (int i = 0; i < boxes.size(); i++)
-		{
-			if (boxes[i].contains(worldPoint))
-				attachment = boxes[i].rect_body;
-		}
+		b2Vec2 point(worldPoint.x, worldPoint.y);
+		b2AABB aabb;
+		b2Vec2 d(0.001f, 0.001f);
+		aabb.lowerBound = point - d;
+		aabb.upperBound = point + d;
+		PickCallback callback(point);
+		world->QueryAABB(&callback, aabb);
 
-		if (attachment != NULL)
+		if (callback.fixture != NULL)
 		{
 			b2MouseJointDef mouseJointDef;
 			mouseJointDef.maxForce = 100;
-			mouseJointDef.bodyA = bodies[0];
-			mouseJointDef.bodyB = attachment;
+			mouseJointDef.bodyA = registry.bodies[registry.indexOf(redCircle)];
+			mouseJointDef.bodyB = callback.fixture->GetBody();
 			mouseJointDef.target = b2Vec2(worldPoint.x, worldPoint.y);
 			mouseJointDef.collideConnected = true;
 			mouseJointDef.maxForce = 100;
@@ -341,8 +625,97 @@ public:
 
 };
 
+// Command line:
+//   --headless       step the world without a window and print timings
+//   --steps N        number of steps for a headless run (default 1000)
+//   --circles N      spawn N circles before running
+//   --boxes N        spawn N boxes before running
+//   --hz N           physics steps per second (default 60)
+//   --fps N          rendered frames per second (default 60)
+//   --frame-stats    print the sub-step count and leftover time per frame,
+//                    and frame, update and render times every 256 frames
+//   --stroke-tolerance T  how far a simplified stroke may stray from the
+//                    drawn one, in world units (default 0.02)
+//   --stroke-stats   print the vertex count of each stroke before and
+//                    after simplification
+//   --profile FILE   record phase timings from the start and write them
+//                    on exit (or on P) to FILE, a Chrome trace if it ends
+//                    in .json, otherwise CSV. P alone writes profile.json
+//   --scene FILE     load the scene in FILE before running, instead of
+//                    starting empty; S saves to FILE and L reloads it
+//                    (default scene.pps)
+//   --save FILE      write the scene to FILE on exit, also headless
+struct Options {
+    bool headless, frameStats, strokeStats;
+    int steps, circles, boxes;
+    float hz, fps, strokeTolerance;
+    const char *profilePath, *scenePath, *savePath;
+    Options(): headless(false), frameStats(false), strokeStats(false),
+               steps(1000), circles(0), boxes(0), hz(60), fps(60),
+               strokeTolerance(0.02), profilePath(NULL), scenePath(NULL),
+               savePath(NULL) {}
+};
+
+Options parseOptions(int argc, char **argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = (i+1 < argc);
+        if (strcmp(argv[i], "--headless") == 0)
+            options.headless = true;
+        else if (strcmp(argv[i], "--steps") == 0 && hasValue)
+            options.steps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--circles") == 0 && hasValue)
+            options.circles = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--boxes") == 0 && hasValue)
+            options.boxes = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--hz") == 0 && hasValue)
+            options.hz = max(atof(argv[++i]), 1.0);
+        else if (strcmp(argv[i], "--fps") == 0 && hasValue)
+            options.fps = max(atof(argv[++i]), 1.0);
+        else if (strcmp(argv[i], "--frame-stats") == 0)
+            options.frameStats = true;
+        else if (strcmp(argv[i], "--stroke-tolerance") == 0 && hasValue)
+            options.strokeTolerance = max(atof(argv[++i]), 0.0);
+        else if (strcmp(argv[i], "--stroke-stats") == 0)
+            options.strokeStats = true;
+        else if (strcmp(argv[i], "--profile") == 0 && hasValue)
+            options.profilePath = argv[++i];
+        else if (strcmp(argv[i], "--scene") == 0 && hasValue)
+            options.scenePath = argv[++i];
+        else if (strcmp(argv[i], "--save") == 0 && hasValue)
+            options.savePath = argv[++i];
+        else
+            fprintf(stderr, "Ignoring unknown argument %s\n", argv[i]);
+    }
+    return options;
+}
+
 int main(int argc, char **argv) {
-    PencilPhysics physics;
-    physics.run();
+    Options options = parseOptions(argc, argv);
+    PencilPhysics physics(options.headless);
+    physics.uiHelper.strokeFilter.tolerance = options.strokeTolerance;
+    physics.uiHelper.strokeStats = options.strokeStats;
+    if (options.profilePath != NULL) {
+        physics.profilePath = options.profilePath;
+        physics.toggleProfiling();
+    }
+    if (options.scenePath != NULL) {
+        physics.scenePath = options.scenePath;
+        physics.loadScene();
+    }
+    for (int i = 0; i < options.circles; i++)
+        physics.addCircle();
+    for (int i = 0; i < options.boxes; i++)
+        physics.addBox();
+    if (options.headless)
+        physics.runHeadless(options.steps, options.hz);
+    else
+        physics.run(options.hz, options.fps, options.frameStats);
+    if (physics.profiler.isRecording())
+        physics.toggleProfiling();
+    if (options.savePath != NULL) {
+        physics.scenePath = options.savePath;
+        physics.saveScene();
+    }
     return EXIT_SUCCESS;
 }
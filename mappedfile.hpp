@@ -0,0 +1,140 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <cstddef>
+#include <string>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only view of a whole file in memory. The OS pages it in on
+// demand, so nothing is copied or allocated up front. mtime is the
+// modification time at the file system's full resolution, in 100 ns
+// ticks on Windows and nanoseconds elsewhere, for equality checks only.
+class MappedFile {
+public:
+    const char *data;
+    size_t size;
+    long long mtime;
+    MappedFile();
+    ~MappedFile();
+    bool open(const std::string &filename);
+    void close();
+protected:
+#ifdef _WIN32
+    HANDLE file, mapping;
+#else
+    int fd;
+#endif
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
+
+// Definitions below
+
+#ifdef _WIN32
+
+inline MappedFile::MappedFile():
+    data(NULL), size(0), mtime(0), file(INVALID_HANDLE_VALUE), mapping(NULL) {}
+
+// Returns false if the file can't be opened or mapped. An empty file
+// opens with data NULL.
+inline bool MappedFile::open(const std::string &filename) {
+    close();
+    file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                       OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER fileSize;
+    FILETIME writeTime;
+    if (!GetFileSizeEx(file, &fileSize) || !GetFileTime(file, NULL, NULL, &writeTime)) {
+        close();
+        return false;
+    }
+    size = (size_t)fileSize.QuadPart;
+    mtime = (long long)writeTime.dwHighDateTime << 32 | writeTime.dwLowDateTime;
+    if (size == 0)
+        return true;
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping != NULL)
+        data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == NULL) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+inline void MappedFile::close() {
+    if (data != NULL)
+        UnmapViewOfFile(data);
+    if (mapping != NULL)
+        CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+    data = NULL;
+    size = 0;
+    mtime = 0;
+    mapping = NULL;
+    file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+inline MappedFile::MappedFile(): data(NULL), size(0), mtime(0), fd(-1) {}
+
+// Returns false if the file can't be opened or mapped. An empty file
+// opens with data NULL.
+inline bool MappedFile::open(const std::string &filename) {
+    close();
+    fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close();
+        return false;
+    }
+    size = st.st_size;
+#ifdef __APPLE__
+    mtime = st.st_mtimespec.tv_sec*1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+    mtime = st.st_mtim.tv_sec*1000000000LL + st.st_mtim.tv_nsec;
+#endif
+    if (size == 0)
+        return true;
+    void *p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+        close();
+        return false;
+    }
+    data = (const char*)p;
+    return true;
+}
+
+inline void MappedFile::close() {
+    if (data != NULL)
+        munmap((void*)data, size);
+    if (fd >= 0)
+        ::close(fd);
+    data = NULL;
+    size = 0;
+    mtime = 0;
+    fd = -1;
+}
+
+#endif
+
+inline MappedFile::~MappedFile() {
+    close();
+}
+
+#endif
@@ -2,10 +2,16 @@
 #define MESH_HPP
 
 #include "engine.hpp"
+#include "mappedfile.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <map>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <glm/glm.hpp>
 using glm::vec2;
@@ -75,14 +81,30 @@ public:
     void makeRectXZ(vec2 xzmin, vec2 xzmax, float y=0);
     void makeSphere(vec3 center, float radius, int slices, int stacks);
     void makeBox(vec3 xyzmin, vec3 xyzmax);
+    void optimize(int cacheSize=16);
     void createGPUData(Engine *engine);
+    void draw();
     std::vector<vec3> vertices;   // vertex positions
     std::vector<vec3> colors;     // vertex colors
     std::vector<vec3> normals;    // vertex normals
     std::vector<vec2> texCoords;  // vertex texture coordinates
     std::vector<ivec3> triangles; // triangle vertex indices
-    VertexBuffer vertexBuffer, colorBuffer, normalBuffer, texCoordBuffer;
+    // Shader attribute locations used by the vertex array object
+    enum {PositionLocation = 0, NormalLocation = 1, TexCoordLocation = 2, ColorLocation = 3};
+    // All attributes interleaved in one buffer, indices as GL_UNSIGNED_SHORT
+    // when there are few enough vertices, and both bound in vao.
+    VertexBuffer vertexBuffer;
     ElementBuffer indexBuffer;
+    GLuint vao;
+    GLenum indexType;
+    int indexCount;
+    Mesh(): vertexBuffer(0), indexBuffer(0), vao(0), indexType(GL_UNSIGNED_INT), indexCount(0) {}
+protected:
+    void parseOBJ(const char *p, const char *end);
+    bool readMeshCache(const std::string &cacheName, long long sourceSize, long long sourceTime,
+                       unsigned long long sourceHash);
+    void writeMeshCache(const std::string &cacheName, long long sourceSize, long long sourceTime,
+                        unsigned long long sourceHash);
 };
 
 inline void Mesh::makeRectXY(vec2 xymin, vec2 xymax, float z) {
@@ -159,6 +181,7 @@ inline void Mesh::makeSphere(vec3 center, float radius, int slices, int stacks)
                 (i+0)+(j+1)*(slices+1)));
         }
     }
+    optimize();
 }
 
 inline void Mesh::makeBox(vec3 xyzmin, vec3 xyzmax) {
@@ -184,64 +207,442 @@ inline void Mesh::makeBox(vec3 xyzmin, vec3 xyzmax) {
     triangles.push_back(ivec3(2,7,3));
 }
 
+// Applies optimize's renumbering to one attribute array, if present.
+template <typename T>
+inline void permuteVertexArray(std::vector<T> &values, const std::vector<int> &remap) {
+    if (values.size() != remap.size())
+        return;
+    std::vector<T> permuted(values.size());
+    for (int v = 0; v < values.size(); v++)
+        permuted[remap[v]] = values[v];
+    values.swap(permuted);
+}
+
+// Reorders the triangles so that consecutive ones share vertices while
+// they are still in a post-transform cache of cacheSize entries (Tipsify,
+// Sander et al. 2007), then renumbers the vertices in order of first use
+// so that the vertex fetches walk memory forwards. Shape and attribute
+// values are unchanged.
+inline void Mesh::optimize(int cacheSize) {
+    int nv = vertices.size(), nt = triangles.size();
+    if (nt == 0)
+        return;
+    // Triangles of each vertex, packed into one array.
+    std::vector<int> live(nv, 0), offsets(nv+1, 0), adjacency(3*nt);
+    for (int t = 0; t < nt; t++)
+        for (int k = 0; k < 3; k++)
+            live[triangles[t][k]]++;
+    for (int v = 0; v < nv; v++)
+        offsets[v+1] = offsets[v] + live[v];
+    std::vector<int> fill(offsets.begin(), offsets.end()-1);
+    for (int t = 0; t < nt; t++)
+        for (int k = 0; k < 3; k++)
+            adjacency[fill[triangles[t][k]]++] = t;
+
+    std::vector<int> cacheTime(nv, 0), deadEnd, candidates;
+    std::vector<char> emitted(nt, 0);
+    std::vector<ivec3> order;
+    order.reserve(nt);
+    int time = cacheSize + 1, cursor = 0, fan = 0;
+    while (fan >= 0) {
+        // Emit every remaining triangle around the fanning vertex.
+        candidates.clear();
+        for (int a = offsets[fan]; a < offsets[fan+1]; a++) {
+            int t = adjacency[a];
+            if (emitted[t])
+                continue;
+            emitted[t] = 1;
+            order.push_back(triangles[t]);
+            for (int k = 0; k < 3; k++) {
+                int v = triangles[t][k];
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cacheTime[v] > cacheSize)
+                    cacheTime[v] = time++;
+            }
+        }
+        // Next, the candidate that will still be in the cache after its
+        // remaining triangles are emitted and has been there longest.
+        fan = -1;
+        int best = -1;
+        for (int c = 0; c < candidates.size(); c++) {
+            int v = candidates[c];
+            if (live[v] <= 0)
+                continue;
+            int priority = 0;
+            if (time - cacheTime[v] + 2*live[v] <= cacheSize)
+                priority = time - cacheTime[v];
+            if (priority > best) {
+                best = priority;
+                fan = v;
+            }
+        }
+        // Otherwise a recently used vertex with triangles left, or else
+        // the next such vertex in input order.
+        while (fan < 0 && !deadEnd.empty()) {
+            int v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0)
+                fan = v;
+        }
+        while (fan < 0 && cursor < nv) {
+            if (live[cursor] > 0)
+                fan = cursor;
+            cursor++;
+        }
+    }
+    triangles.swap(order);
+
+    std::vector<int> remap(nv, -1);
+    int next = 0;
+    for (int t = 0; t < nt; t++) {
+        for (int k = 0; k < 3; k++) {
+            int &v = triangles[t][k];
+            if (remap[v] < 0)
+                remap[v] = next++;
+            v = remap[v];
+        }
+    }
+    for (int v = 0; v < nv; v++)
+        if (remap[v] < 0)
+            remap[v] = next++; // unused vertices go last
+    permuteVertexArray(vertices, remap);
+    permuteVertexArray(colors, remap);
+    permuteVertexArray(normals, remap);
+    permuteVertexArray(texCoords, remap);
+}
+
+// Uploads the mesh as one interleaved vertex buffer (position, then
+// normal, texture coordinate and color if present) and an index buffer,
+// and records the attribute layout in a vertex array object, so drawing
+// is a single bind.
 inline void Mesh::createGPUData(Engine *engine) {
-    vertexBuffer = engine->allocateVertexBuffer(vertices);
-    if (!colors.empty())
-        colorBuffer = engine->allocateVertexBuffer(colors);
-    if (!normals.empty())
-        normalBuffer = engine->allocateVertexBuffer(normals);
-    if (!texCoords.empty())
-        texCoordBuffer = engine->allocateVertexBuffer(texCoords);
-    std::vector<int> indices;
-    for (int t = 0; t < triangles.size(); t++) {
-        indices.push_back(triangles[t][0]);
-        indices.push_back(triangles[t][1]);
-        indices.push_back(triangles[t][2]);
+    int nv = vertices.size();
+    bool hasNormals = (normals.size() == nv), hasTexCoords = (texCoords.size() == nv),
+        hasColors = (colors.size() == nv);
+    int stride = 3 + (hasNormals ? 3 : 0) + (hasTexCoords ? 2 : 0) + (hasColors ? 3 : 0);
+    std::vector<float> data;
+    data.reserve(nv*stride);
+    for (int v = 0; v < nv; v++) {
+        data.insert(data.end(), &vertices[v][0], &vertices[v][0] + 3);
+        if (hasNormals)
+            data.insert(data.end(), &normals[v][0], &normals[v][0] + 3);
+        if (hasTexCoords)
+            data.insert(data.end(), &texCoords[v][0], &texCoords[v][0] + 2);
+        if (hasColors)
+            data.insert(data.end(), &colors[v][0], &colors[v][0] + 3);
     }
-    indexBuffer = engine->allocateElementBuffer(indices);
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    vertexBuffer = engine->allocateVertexBuffer(data);
+    int offset = 0;
+    GLuint locations[] = {PositionLocation, NormalLocation, TexCoordLocation, ColorLocation};
+    int sizes[] = {3, hasNormals ? 3 : 0, hasTexCoords ? 2 : 0, hasColors ? 3 : 0};
+    for (int a = 0; a < 4; a++) {
+        if (sizes[a] == 0)
+            continue;
+        glVertexAttribPointer(locations[a], sizes[a], GL_FLOAT, GL_FALSE, stride*sizeof(float),
+                              (void*)(intptr_t)(offset*sizeof(float)));
+        glEnableVertexAttribArray(locations[a]);
+        offset += sizes[a];
+    }
+    // The triangles are already packed as 3 ints each.
+    indexCount = 3*triangles.size();
+    const int *indices = triangles.empty() ? NULL : &triangles[0][0];
+    if (nv <= 65536) {
+        std::vector<unsigned short> shortIndices(indices, indices + indexCount);
+        indexBuffer = engine->allocateElementBuffer(shortIndices);
+        indexType = GL_UNSIGNED_SHORT;
+    } else {
+        std::vector<int> intIndices(indices, indices + indexCount);
+        indexBuffer = engine->allocateElementBuffer(intIndices);
+        indexType = GL_UNSIGNED_INT;
+    }
+    glBindVertexArray(0);
+    Engine::dieIfOpenGLError();
 }
 
-// Extremely crude OBJ file loader. May not work for general OBJ files.
-// Do not use outside of the simple example meshes provided in this course.
+// Draws the triangles with whatever shader is enabled, which should read
+// the attributes at the Mesh locations.
+inline void Mesh::draw() {
+    glBindVertexArray(vao);
+    glDrawElements(GL_TRIANGLES, indexCount, indexType, 0);
+    glBindVertexArray(0);
+    Engine::dieIfOpenGLError();
+}
+
+// Scanners for the OBJ loader. Each reads one number at p, stops at end,
+// and returns where it stopped.
+
+inline const char* skipOBJSpace(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    return p;
+}
+
+inline const char* skipOBJLine(const char *p, const char *end) {
+    while (p < end && *p != '\n')
+        p++;
+    return (p < end) ? p+1 : p;
+}
+
+inline const char* scanOBJInt(const char *p, const char *end, int *value) {
+    bool negative = (p < end && *p == '-');
+    if (p < end && (*p == '-' || *p == '+'))
+        p++;
+    int n = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+        n = 10*n + (*p++ - '0');
+    *value = negative ? -n : n;
+    return p;
+}
+
+// Up to 18 significant digits are kept; that is more than a float holds.
+inline const char* scanOBJFloat(const char *p, const char *end, float *value) {
+    bool negative = (p < end && *p == '-');
+    if (p < end && (*p == '-' || *p == '+'))
+        p++;
+    long long mantissa = 0;
+    int digits = 0, exponent = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (digits < 18) {
+            mantissa = 10*mantissa + (*p - '0');
+            if (mantissa != 0)
+                digits++;
+        } else {
+            exponent++;
+        }
+        p++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (digits < 18) {
+                mantissa = 10*mantissa + (*p - '0');
+                if (mantissa != 0)
+                    digits++;
+                exponent--;
+            }
+            p++;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        int e;
+        p = scanOBJInt(p+1, end, &e);
+        exponent += e;
+    }
+    double v = (double)mantissa;
+    if (exponent != 0)
+        v *= std::pow(10.0, exponent);
+    *value = (float)(negative ? -v : v);
+    return p;
+}
+
+// One corner of an OBJ face: indices of its position, texture coordinate
+// and normal, -1 where the face doesn't give one.
+struct OBJCorner {
+    int v, vt, vn;
+    bool operator==(const OBJCorner &c) const { return v == c.v && vt == c.vt && vn == c.vn; }
+};
+
+struct OBJCornerHash {
+    size_t operator()(const OBJCorner &c) const {
+        return (size_t)c.v*73856093u ^ (size_t)c.vt*19349663u ^ (size_t)c.vn*83492791u;
+    }
+};
+
+// Header of the binary cache that loadOBJ writes next to an OBJ file. The
+// arrays follow in the order of the counts. The cache is only used while
+// the OBJ file's size, full resolution modification time and hashOBJEnds
+// match. The hash only covers the first and last 4 KB, so of the edits
+// that keep both the size and the time, it only catches those there.
+struct MeshCacheHeader {
+    char magic[4];
+    unsigned int version;
+    long long sourceSize, sourceTime;
+    unsigned long long sourceHash;
+    int vertexCount, normalCount, texCoordCount, triangleCount;
+};
+
+// FNV-1a hash of the first and last HashBytes bytes of a file, so that
+// checking a cache only touches two pages of a large OBJ file.
+inline unsigned long long hashOBJEnds(const char *data, size_t size) {
+    const size_t HashBytes = 4096;
+    unsigned long long hash = 14695981039346656037ull;
+    size_t head = std::min(size, HashBytes);
+    size_t tail = std::max(head, size - head);
+    for (size_t i = 0; i < head; i++)
+        hash = (hash ^ (unsigned char)data[i]) * 1099511628211ull;
+    for (size_t i = tail; i < size; i++)
+        hash = (hash ^ (unsigned char)data[i]) * 1099511628211ull;
+    return hash;
+}
+
+// Loads an OBJ file. Faces may give v, v/vt, v//vn or v/vt/vn for each
+// corner, with negative indices counting back from the end; polygons are
+// split into fans. Corners with the same indices share one vertex. The
+// first load optimizes the mesh and writes it to filename.cache, and later
+// loads of the unchanged file read the arrays from it directly.
 inline void Mesh::loadOBJ(const std::string &filename) {
-    std::fstream file(filename.c_str(), std::ios::in);
-    if (!file) {
+    MappedFile file;
+    if (!file.open(filename)) {
         Engine::errorMessage("Failed to load " + filename);
         exit(EXIT_FAILURE);
     }
-    while (file) {
-        std::string line;
-        do
-            getline(file, line);
-        while (file && (line.length() == 0 || line[0] == '#'));
-        std::stringstream linestream(line);
-        std::string keyword;
-        linestream >> keyword;
-        if (keyword == "v") {
-            vec3 vertex;
-            linestream >> vertex[0] >> vertex[1] >> vertex[2];
-            vertices.push_back(vertex);
-        } else if (keyword == "vn") {
-            vec3 normal;
-            linestream >> normal[0] >> normal[1] >> normal[2];
-            normals.push_back(normal);
-        } else if (keyword == "vt") {
-            vec2 texCoord;
-            linestream >> texCoord[0] >> texCoord[1];
-            texCoords.push_back(texCoord);
-        } else if (keyword == "f") {
-            std::vector<int> polygon;
-            std::string word;
-            while (linestream >> word) {
-                std::stringstream wstream(word);
-                int v;
-                wstream >> v;
-                polygon.push_back(v-1); // In OBJ files, indices start from 1
+    std::string cacheName = filename + ".cache";
+    unsigned long long hash = hashOBJEnds(file.data, file.size);
+    if (readMeshCache(cacheName, file.size, file.mtime, hash))
+        return;
+    parseOBJ(file.data, file.data + file.size);
+    optimize();
+    writeMeshCache(cacheName, file.size, file.mtime, hash);
+}
+
+inline void Mesh::parseOBJ(const char *p, const char *end) {
+    std::vector<vec3> positions, objNormals;
+    std::vector<vec2> objTexCoords;
+    std::vector<OBJCorner> corners;
+    std::vector<int> polygon;
+    std::unordered_map<OBJCorner, int, OBJCornerHash> indices;
+    while (p < end) {
+        p = skipOBJSpace(p, end);
+        const char *keyword = p;
+        while (p < end && *p > ' ')
+            p++;
+        int length = p - keyword;
+        if (length == 1 && keyword[0] == 'v') {
+            vec3 v;
+            for (int i = 0; i < 3; i++)
+                p = scanOBJFloat(skipOBJSpace(p, end), end, &v[i]);
+            positions.push_back(v);
+        } else if (length == 2 && keyword[0] == 'v' && keyword[1] == 'n') {
+            vec3 n;
+            for (int i = 0; i < 3; i++)
+                p = scanOBJFloat(skipOBJSpace(p, end), end, &n[i]);
+            objNormals.push_back(n);
+        } else if (length == 2 && keyword[0] == 'v' && keyword[1] == 't') {
+            vec2 t;
+            for (int i = 0; i < 2; i++)
+                p = scanOBJFloat(skipOBJSpace(p, end), end, &t[i]);
+            objTexCoords.push_back(t);
+        } else if (length == 1 && keyword[0] == 'f') {
+            corners.clear();
+            for (;;) {
+                p = skipOBJSpace(p, end);
+                if (p == end || *p == '\n' || *p == '\r' || *p == '#')
+                    break;
+                OBJCorner c = {0, 0, 0};
+                p = scanOBJInt(p, end, &c.v);
+                if (p < end && *p == '/') {
+                    p++;
+                    if (p < end && *p != '/')
+                        p = scanOBJInt(p, end, &c.vt);
+                    if (p < end && *p == '/')
+                        p = scanOBJInt(p+1, end, &c.vn);
+                }
+                // In OBJ files, indices start from 1, and 0 means none
+                c.v = (c.v < 0) ? (int)positions.size() + c.v : c.v - 1;
+                c.vt = (c.vt < 0) ? (int)objTexCoords.size() + c.vt : c.vt - 1;
+                c.vn = (c.vn < 0) ? (int)objNormals.size() + c.vn : c.vn - 1;
+                corners.push_back(c);
+                while (p < end && *p > ' ')
+                    p++;
+            }
+            polygon.clear();
+            for (int i = 0; i < corners.size(); i++) {
+                std::pair<std::unordered_map<OBJCorner, int, OBJCornerHash>::iterator, bool> found =
+                    indices.insert(std::make_pair(corners[i], (int)indices.size()));
+                polygon.push_back(found.first->second);
             }
             for (int i = 2; i < polygon.size(); i++)
                 triangles.push_back(ivec3(polygon[0], polygon[i-1], polygon[i]));
         }
+        p = skipOBJLine(p, end);
     }
+    // Corners without a normal or texture coordinate index take the one
+    // at their position index, for files that keep the arrays parallel.
+    int n = indices.size();
+    vertices.resize(n);
+    if (!objNormals.empty())
+        normals.resize(n);
+    if (!objTexCoords.empty())
+        texCoords.resize(n);
+    std::unordered_map<OBJCorner, int, OBJCornerHash>::iterator it;
+    for (it = indices.begin(); it != indices.end(); ++it) {
+        const OBJCorner &c = it->first;
+        int i = it->second;
+        if (c.v >= 0 && c.v < positions.size())
+            vertices[i] = positions[c.v];
+        if (!objNormals.empty()) {
+            int vn = (c.vn >= 0) ? c.vn : c.v;
+            if (vn >= 0 && vn < objNormals.size())
+                normals[i] = objNormals[vn];
+        }
+        if (!objTexCoords.empty()) {
+            int vt = (c.vt >= 0) ? c.vt : c.v;
+            if (vt >= 0 && vt < objTexCoords.size())
+                texCoords[i] = objTexCoords[vt];
+        }
+    }
+}
+
+// Returns false, leaving the mesh alone, if there is no cache for this
+// version of the source file.
+inline bool Mesh::readMeshCache(const std::string &cacheName, long long sourceSize,
+                                long long sourceTime, unsigned long long sourceHash) {
+    MappedFile file;
+    if (!file.open(cacheName) || file.size < sizeof(MeshCacheHeader))
+        return false;
+    MeshCacheHeader h;
+    memcpy(&h, file.data, sizeof(h));
+    if (memcmp(h.magic, "OBJC", 4) != 0 || h.version != 4 ||
+        h.sourceSize != sourceSize || h.sourceTime != sourceTime ||
+        h.sourceHash != sourceHash)
+        return false;
+    size_t bytes = sizeof(h) + h.vertexCount*sizeof(vec3) + h.normalCount*sizeof(vec3) +
+        h.texCoordCount*sizeof(vec2) + h.triangleCount*sizeof(ivec3);
+    if (file.size != bytes)
+        return false;
+    const char *p = file.data + sizeof(h);
+    vertices.assign((const vec3*)p, (const vec3*)p + h.vertexCount);
+    p += h.vertexCount*sizeof(vec3);
+    normals.assign((const vec3*)p, (const vec3*)p + h.normalCount);
+    p += h.normalCount*sizeof(vec3);
+    texCoords.assign((const vec2*)p, (const vec2*)p + h.texCoordCount);
+    p += h.texCoordCount*sizeof(vec2);
+    triangles.assign((const ivec3*)p, (const ivec3*)p + h.triangleCount);
+    return true;
+}
+
+// The cache only saves time, so failing to write it is not an error.
+inline void Mesh::writeMeshCache(const std::string &cacheName, long long sourceSize,
+                                 long long sourceTime, unsigned long long sourceHash) {
+    FILE *file = fopen(cacheName.c_str(), "wb");
+    if (file == NULL)
+        return;
+    MeshCacheHeader h;
+    memcpy(h.magic, "OBJC", 4);
+    h.version = 4;
+    h.sourceSize = sourceSize;
+    h.sourceTime = sourceTime;
+    h.sourceHash = sourceHash;
+    h.vertexCount = vertices.size();
+    h.normalCount = normals.size();
+    h.texCoordCount = texCoords.size();
+    h.triangleCount = triangles.size();
+    fwrite(&h, sizeof(h), 1, file);
+    if (!vertices.empty())
+        fwrite(&vertices[0], sizeof(vec3), vertices.size(), file);
+    if (!normals.empty())
+        fwrite(&normals[0], sizeof(vec3), normals.size(), file);
+    if (!texCoords.empty())
+        fwrite(&texCoords[0], sizeof(vec2), texCoords.size(), file);
+    if (!triangles.empty())
+        fwrite(&triangles[0], sizeof(ivec3), triangles.size(), file);
+    bool failed = ferror(file) != 0;
+    if (fclose(file) != 0 || failed)
+        remove(cacheName.c_str());
 }
 
 #endif
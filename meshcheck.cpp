@@ -0,0 +1,123 @@
+// Checks Mesh::loadOBJ and its binary cache on small OBJ files in the
+// current directory, and exits with EXIT_FAILURE if anything is off. It
+// is built on its own from this file, with the same headers and libraries
+// as main.cpp, and keeps the check code out of mesh.hpp and the app.
+//
+// Usage: meshcheck
+
+#include "mesh.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+bool sameMesh(const Mesh &a, const Mesh &b) {
+    return a.vertices == b.vertices && a.normals == b.normals &&
+        a.texCoords == b.texCoords && a.triangles == b.triangles;
+}
+
+// Sets the modification time of filename to mtime, in the units of
+// MappedFile::mtime.
+bool setFileTime(const std::string &filename, long long mtime) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, 0, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    FILETIME writeTime;
+    writeTime.dwLowDateTime = (DWORD)mtime;
+    writeTime.dwHighDateTime = (DWORD)(mtime >> 32);
+    bool ok = SetFileTime(file, NULL, NULL, &writeTime) != 0;
+    CloseHandle(file);
+    return ok;
+#else
+    struct timespec times[2];
+    times[0].tv_sec = 0;
+    times[0].tv_nsec = UTIME_OMIT;
+    times[1].tv_sec = mtime / 1000000000;
+    times[1].tv_nsec = mtime % 1000000000;
+    return utimensat(AT_FDCWD, filename.c_str(), times, 0) == 0;
+#endif
+}
+
+// Writes text to filename, with its modification time set to mtime unless
+// that is 0. Returns false if the file couldn't be written.
+bool writeCheckFile(const std::string &filename, const char *text, long long mtime) {
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (file == NULL)
+        return false;
+    bool ok = fputs(text, file) >= 0;
+    if (fclose(file) != 0 || !ok)
+        return false;
+    return mtime == 0 || setFileTime(filename, mtime);
+}
+
+// Round trip check of loadOBJ on small files named after prefix, which
+// are removed afterwards. Checks that negative indices resolve like
+// positive ones for v/vt/vn and v//vn corners, that a cached load gives
+// the parsed mesh, and that an edit keeping the size and modification
+// time still misses the cache. Prints the first failure.
+bool checkMeshCache(const std::string &prefix) {
+    const char *positive =
+        "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 0 0 1\n"
+        "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+        "vn 0 0 1\nvn 0 1 0\n"
+        "f 1/1/1 2/2/1 3/3/1 4/4/1\n"
+        "f 1//2 2//2 5//2\n";
+    const char *negative =
+        "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 0 0 1\n"
+        "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+        "vn 0 0 1\nvn 0 1 0\n"
+        "f -5/-4/-2 -4/-3/-2 -3/-2/-2 -2/-1/-2\n"
+        "f -5//-1 -4//-1 -1//-1\n";
+    // The positive file with the last vertex moved, at the same size.
+    const char *edited =
+        "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 0 0 2\n"
+        "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+        "vn 0 0 1\nvn 0 1 0\n"
+        "f 1/1/1 2/2/1 3/3/1 4/4/1\n"
+        "f 1//2 2//2 5//2\n";
+    std::string positiveName = prefix + "-positive.obj";
+    std::string negativeName = prefix + "-negative.obj";
+    remove((positiveName + ".cache").c_str());
+    remove((negativeName + ".cache").c_str());
+    const char *failure = NULL;
+    Mesh parsed, cached, negativeParsed, editedCached, editedParsed;
+    MappedFile original;
+    if (!writeCheckFile(positiveName, positive, 0) ||
+        !writeCheckFile(negativeName, negative, 0) ||
+        !original.open(positiveName)) {
+        failure = "couldn't write the OBJ files";
+    } else {
+        // Closed so that it can be written over on Windows.
+        long long mtime = original.mtime;
+        original.close();
+        parsed.loadOBJ(positiveName);
+        cached.loadOBJ(positiveName);
+        negativeParsed.loadOBJ(negativeName);
+        if (parsed.triangles.size() != 3 || parsed.vertices.size() != 7)
+            failure = "parsed mesh has the wrong size";
+        else if (!sameMesh(parsed, negativeParsed))
+            failure = "negative indices parse differently";
+        else if (!sameMesh(parsed, cached))
+            failure = "cached load differs from parse";
+        else if (!writeCheckFile(positiveName, edited, mtime))
+            failure = "couldn't edit the OBJ file";
+        else {
+            editedCached.loadOBJ(positiveName);
+            remove((positiveName + ".cache").c_str());
+            editedParsed.loadOBJ(positiveName);
+            if (sameMesh(editedCached, parsed) || !sameMesh(editedCached, editedParsed))
+                failure = "edit with the same size and time used the old cache";
+        }
+    }
+    remove(positiveName.c_str());
+    remove(negativeName.c_str());
+    remove((positiveName + ".cache").c_str());
+    remove((negativeName + ".cache").c_str());
+    printf("mesh cache: %s\n", failure ? failure : "ok");
+    return failure == NULL;
+}
+
+int main(int argc, char **argv) {
+    return checkMeshCache("mesh-check") ? EXIT_SUCCESS : EXIT_FAILURE;
+}
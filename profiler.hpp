@@ -0,0 +1,152 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include "engine.hpp"
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <Box2D/Box2D.h>
+
+// Records named time spans from the render and physics threads while
+// recording is on, and writes them out when it stops: as a Chrome
+// trace-event file (opens in chrome://tracing or Perfetto) if the path
+// ends in .json, otherwise as CSV with one span per row. Times come from
+// Engine::nanoseconds().
+class Profiler {
+public:
+    enum Track {RenderTrack, PhysicsTrack};
+    Profiler(): recording(false), origin(0) {}
+    void start(const std::string &path);
+    bool stop();
+    bool isRecording() const;
+    const std::string& outputPath() const;
+    void add(Track track, const char *name, Uint64 start, Uint64 end);
+    void addStep(Uint64 start, const b2Profile &profile);
+protected:
+    struct Event {
+        const char *name;
+        Track track;
+        Uint64 start, duration;
+    };
+    std::atomic<bool> recording;
+    std::mutex mutex;
+    std::vector<Event> events;
+    std::string path;
+    Uint64 origin;
+    bool writeTrace(FILE *file);
+    bool writeCSV(FILE *file);
+};
+
+// Adds a span from its construction to the end of the enclosing scope.
+class ProfileScope {
+public:
+    ProfileScope(Profiler &profiler, Profiler::Track track, const char *name):
+        profiler(profiler), track(track), name(name),
+        start(profiler.isRecording() ? Engine::nanoseconds() : 0) {}
+    ~ProfileScope() {
+        if (start != 0)
+            profiler.add(track, name, start, Engine::nanoseconds());
+    }
+protected:
+    Profiler &profiler;
+    Profiler::Track track;
+    const char *name;
+    Uint64 start;
+};
+
+// Definitions below
+
+// Drops anything recorded before, so each file covers one recording.
+inline void Profiler::start(const std::string &path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->path = path;
+    events.clear();
+    origin = Engine::nanoseconds();
+    recording = true;
+}
+
+// Stops recording and writes the file. Returns false if it couldn't be
+// written.
+inline bool Profiler::stop() {
+    recording = false;
+    std::lock_guard<std::mutex> lock(mutex);
+    FILE *file = fopen(path.c_str(), "w");
+    if (file == NULL)
+        return false;
+    bool json = path.size() >= 5 && path.compare(path.size()-5, 5, ".json") == 0;
+    bool ok = json ? writeTrace(file) : writeCSV(file);
+    return (fclose(file) == 0) && ok;
+}
+
+inline bool Profiler::isRecording() const {
+    return recording.load(std::memory_order_relaxed);
+}
+
+inline const std::string& Profiler::outputPath() const {
+    return path;
+}
+
+inline void Profiler::add(Track track, const char *name, Uint64 start, Uint64 end) {
+    if (!isRecording())
+        return;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (start < origin)
+        start = origin;
+    Event event = {name, track, start - origin, (end > start) ? end - start : 0};
+    events.push_back(event);
+}
+
+// b2World::Step only reports how long each phase took, so the phases are
+// laid out back to back in the order Step runs them, starting at start.
+inline void Profiler::addStep(Uint64 start, const b2Profile &profile) {
+    if (!isRecording())
+        return;
+    const Uint64 ns = 1000000; // per millisecond
+    Uint64 t = start;
+    add(PhysicsTrack, "b2World::Step", t, t + (Uint64)(profile.step*ns));
+    add(PhysicsTrack, "collide", t, t + (Uint64)(profile.collide*ns));
+    t += (Uint64)(profile.collide*ns);
+    add(PhysicsTrack, "solve", t, t + (Uint64)(profile.solve*ns));
+    Uint64 u = t;
+    add(PhysicsTrack, "solveInit", u, u + (Uint64)(profile.solveInit*ns));
+    u += (Uint64)(profile.solveInit*ns);
+    add(PhysicsTrack, "solveVelocity", u, u + (Uint64)(profile.solveVelocity*ns));
+    u += (Uint64)(profile.solveVelocity*ns);
+    add(PhysicsTrack, "solvePosition", u, u + (Uint64)(profile.solvePosition*ns));
+    // Solve finds the new contacts last, after the islands.
+    add(PhysicsTrack, "broadphase", t + (Uint64)((profile.solve - profile.broadphase)*ns),
+        t + (Uint64)(profile.solve*ns));
+    t += (Uint64)(profile.solve*ns);
+    add(PhysicsTrack, "solveTOI", t, t + (Uint64)(profile.solveTOI*ns));
+}
+
+inline bool Profiler::writeTrace(FILE *file) {
+    const char *trackNames[] = {"render", "physics"};
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (int i = 0; i < 2; i++)
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                "\"args\":{\"name\":\"%s\"}}\n", (i > 0) ? "," : "", i, trackNames[i]);
+    for (int i = 0; i < events.size(); i++) {
+        const Event &e = events[i];
+        fprintf(file, ",{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                "\"ts\":%.3f,\"dur\":%.3f}\n", e.name, (int)e.track,
+                e.start*1e-3, e.duration*1e-3);
+    }
+    fprintf(file, "]}\n");
+    return !ferror(file);
+}
+
+inline bool Profiler::writeCSV(FILE *file) {
+    const char *trackNames[] = {"render", "physics"};
+    fprintf(file, "thread,name,start_ms,duration_ms\n");
+    for (int i = 0; i < events.size(); i++) {
+        const Event &e = events[i];
+        fprintf(file, "%s,%s,%.6f,%.6f\n", trackNames[e.track], e.name,
+                e.start*1e-6, e.duration*1e-6);
+    }
+    return !ferror(file);
+}
+
+#endif
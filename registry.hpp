@@ -0,0 +1,222 @@
+#ifndef REGISTRY_HPP
+#define REGISTRY_HPP
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <Box2D/Box2D.h>
+using glm::vec2;
+using glm::vec3;
+
+enum BodyKind {CircleBody, BoxBody};
+
+// Drawable state of a set of bodies, one array per field, all in the same
+// order. Circles use size (radius, radius), as in Instance2D. The
+// previous pose is the one before the last step, for interpolation.
+struct BodyArrays {
+    std::vector<unsigned char> kinds;
+    std::vector<vec2> sizes;
+    std::vector<vec3> colors;
+    std::vector<vec2> positions, previousPositions;
+    std::vector<float> angles, previousAngles;
+    int size() const { return kinds.size(); }
+    void assign(const BodyArrays &from, const std::vector<int> &indices);
+};
+
+// Stable name for a registered body. Removing the body bumps the
+// generation of its slot, so an old id can't reach the slot's next body.
+struct BodyId {
+    int slot, generation;
+};
+
+// Keeps the circles and boxes in dense arrays so that syncing with Box2D
+// and drawing are linear passes. Removal moves the last entry into the
+// hole; ids stay valid across that because they go through the slot table.
+// Each body's user data holds its slot, so a b2Body found by a world query
+// leads back to its entry.
+class BodyRegistry {
+public:
+    // Indexed like the arrays. Read freely, change only through the methods.
+    BodyArrays arrays;
+    std::vector<b2Body*> bodies;
+
+    void reserve(int capacity);
+    BodyId add(b2Body *body, BodyKind kind, vec2 size, vec3 color);
+    void remove(BodyId id);
+    void removeAt(int index);
+    bool contains(BodyId id) const;
+    int indexOf(BodyId id) const;
+    int indexOf(const b2Body *body) const;
+    BodyId idAt(int index) const;
+    int size() const;
+    void sync();
+protected:
+    std::vector<int> slotOfIndex;
+    std::vector<int> indexOfSlot;
+    std::vector<int> generations;
+    std::vector<int> freeSlots;
+    // Whether each body was awake at the last sync, indexed like the arrays.
+    std::vector<unsigned char> awakeAtSync;
+};
+
+// Definitions below
+
+// Makes these arrays a copy of the given entries of from, in that order.
+inline void BodyArrays::assign(const BodyArrays &from, const std::vector<int> &indices) {
+    int n = indices.size();
+    kinds.resize(n);
+    sizes.resize(n);
+    colors.resize(n);
+    positions.resize(n);
+    previousPositions.resize(n);
+    angles.resize(n);
+    previousAngles.resize(n);
+    for (int i = 0; i < n; i++) {
+        int j = indices[i];
+        kinds[i] = from.kinds[j];
+        sizes[i] = from.sizes[j];
+        colors[i] = from.colors[j];
+        positions[i] = from.positions[j];
+        previousPositions[i] = from.previousPositions[j];
+        angles[i] = from.angles[j];
+        previousAngles[i] = from.previousAngles[j];
+    }
+}
+
+// Makes room for capacity bodies in total, so adding many at once, as
+// when a scene is loaded, doesn't grow the arrays repeatedly.
+inline void BodyRegistry::reserve(int capacity) {
+    bodies.reserve(capacity);
+    slotOfIndex.reserve(capacity);
+    indexOfSlot.reserve(capacity);
+    generations.reserve(capacity);
+    awakeAtSync.reserve(capacity);
+    arrays.kinds.reserve(capacity);
+    arrays.sizes.reserve(capacity);
+    arrays.colors.reserve(capacity);
+    arrays.positions.reserve(capacity);
+    arrays.previousPositions.reserve(capacity);
+    arrays.angles.reserve(capacity);
+    arrays.previousAngles.reserve(capacity);
+}
+
+inline BodyId BodyRegistry::add(b2Body *body, BodyKind kind, vec2 size, vec3 color) {
+    int slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        slot = generations.size();
+        generations.push_back(0);
+        indexOfSlot.push_back(-1);
+    }
+    int index = bodies.size();
+    indexOfSlot[slot] = index;
+    slotOfIndex.push_back(slot);
+    bodies.push_back(body);
+    awakeAtSync.push_back(body->IsAwake());
+    body->SetUserData((void*)(intptr_t)(slot + 1));
+    const b2Vec2 &p = body->GetPosition();
+    arrays.kinds.push_back(kind);
+    arrays.sizes.push_back(size);
+    arrays.colors.push_back(color);
+    arrays.positions.push_back(vec2(p.x, p.y));
+    arrays.previousPositions.push_back(vec2(p.x, p.y));
+    arrays.angles.push_back(body->GetAngle());
+    arrays.previousAngles.push_back(body->GetAngle());
+    BodyId id = {slot, generations[slot]};
+    return id;
+}
+
+// Forgets the body; destroying the b2Body is up to the caller.
+inline void BodyRegistry::remove(BodyId id) {
+    int index = indexOf(id);
+    if (index >= 0)
+        removeAt(index);
+}
+
+inline void BodyRegistry::removeAt(int index) {
+    int last = bodies.size() - 1;
+    int slot = slotOfIndex[index];
+    bodies[index]->SetUserData(NULL);
+    generations[slot]++;
+    indexOfSlot[slot] = -1;
+    freeSlots.push_back(slot);
+    if (index != last) {
+        slotOfIndex[index] = slotOfIndex[last];
+        indexOfSlot[slotOfIndex[index]] = index;
+        bodies[index] = bodies[last];
+        awakeAtSync[index] = awakeAtSync[last];
+        arrays.kinds[index] = arrays.kinds[last];
+        arrays.sizes[index] = arrays.sizes[last];
+        arrays.colors[index] = arrays.colors[last];
+        arrays.positions[index] = arrays.positions[last];
+        arrays.previousPositions[index] = arrays.previousPositions[last];
+        arrays.angles[index] = arrays.angles[last];
+        arrays.previousAngles[index] = arrays.previousAngles[last];
+    }
+    slotOfIndex.pop_back();
+    bodies.pop_back();
+    awakeAtSync.pop_back();
+    arrays.kinds.pop_back();
+    arrays.sizes.pop_back();
+    arrays.colors.pop_back();
+    arrays.positions.pop_back();
+    arrays.previousPositions.pop_back();
+    arrays.angles.pop_back();
+    arrays.previousAngles.pop_back();
+}
+
+inline bool BodyRegistry::contains(BodyId id) const {
+    return indexOf(id) >= 0;
+}
+
+// Returns the current index of the body in the arrays, or -1 if the id is
+// stale.
+inline int BodyRegistry::indexOf(BodyId id) const {
+    if (id.slot < 0 || id.slot >= generations.size() ||
+        generations[id.slot] != id.generation)
+        return -1;
+    return indexOfSlot[id.slot];
+}
+
+// Returns -1 for bodies that aren't in the registry, such as the chains.
+inline int BodyRegistry::indexOf(const b2Body *body) const {
+    int slot = (int)(intptr_t)body->GetUserData() - 1;
+    if (slot < 0 || slot >= indexOfSlot.size())
+        return -1;
+    return indexOfSlot[slot];
+}
+
+inline BodyId BodyRegistry::idAt(int index) const {
+    int slot = slotOfIndex[index];
+    BodyId id = {slot, generations[slot]};
+    return id;
+}
+
+inline int BodyRegistry::size() const {
+    return bodies.size();
+}
+
+// Call once after each world step. Moves the current pose to the previous
+// one and reads the new pose of every body that can have moved. A body
+// still moves in the step that puts it to sleep, so bodies that were
+// awake at the last sync are read too.
+inline void BodyRegistry::sync() {
+    int n = bodies.size();
+    for (int i = 0; i < n; i++) {
+        arrays.previousPositions[i] = arrays.positions[i];
+        arrays.previousAngles[i] = arrays.angles[i];
+        const b2Body *body = bodies[i];
+        bool awake = body->IsAwake();
+        bool wasAwake = awakeAtSync[i];
+        awakeAtSync[i] = awake;
+        if (!awake && !wasAwake)
+            continue;
+        const b2Vec2 &p = body->GetPosition();
+        arrays.positions[i] = vec2(p.x, p.y);
+        arrays.angles[i] = body->GetAngle();
+    }
+}
+
+#endif
@@ -0,0 +1,173 @@
+#ifndef SCENE_HPP
+#define SCENE_HPP
+
+#include "mappedfile.hpp"
+#include "registry.hpp"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <Box2D/Box2D.h>
+using glm::vec2;
+using glm::vec3;
+
+// A scene file is a SceneHeader, then bodyCount SceneBody records, then
+// the vertex count of each of the polylineCount polylines, then all of
+// their vertices back to back. Records are stored as they are in memory,
+// so the file only loads on machines with the same byte order.
+struct SceneHeader {
+    char magic[4];
+    unsigned int version;
+    int bodyCount, polylineCount, vertexCount;
+};
+
+struct SceneBody {
+    unsigned char kind, awake, padding[2];
+    vec2 size;
+    vec3 color;
+    vec2 position;
+    float angle;
+    vec2 linearVelocity;
+    float angularVelocity;
+};
+
+// Collects a scene in memory and writes it out with a single fwrite.
+class SceneWriter {
+public:
+    void addBody(const b2Body *body, BodyKind kind, vec2 size, vec3 color);
+    void addPolyline(const std::vector<vec2> &vertices);
+    bool write(const std::string &path) const;
+protected:
+    std::vector<SceneBody> bodies;
+    std::vector<int> polylineSizes;
+    std::vector<vec2> vertices;
+};
+
+// Maps a scene file and points straight into it, so reading a scene
+// copies nothing until the bodies are created. The pointers stay valid
+// until the reader is closed or destroyed.
+class SceneReader {
+public:
+    int bodyCount, polylineCount;
+    const SceneBody *bodies;
+    const int *polylineSizes;
+    const vec2 *vertices;
+    SceneReader(): bodyCount(0), polylineCount(0), bodies(NULL),
+                   polylineSizes(NULL), vertices(NULL) {}
+    bool open(const std::string &path);
+    void close();
+    b2BodyDef bodyDef(int index) const;
+protected:
+    MappedFile file;
+};
+
+// Definitions below
+
+inline void SceneWriter::addBody(const b2Body *body, BodyKind kind, vec2 size, vec3 color) {
+    SceneBody b;
+    b.kind = kind;
+    b.awake = body->IsAwake();
+    b.padding[0] = b.padding[1] = 0;
+    b.size = size;
+    b.color = color;
+    b.position = vec2(body->GetPosition().x, body->GetPosition().y);
+    b.angle = body->GetAngle();
+    b.linearVelocity = vec2(body->GetLinearVelocity().x, body->GetLinearVelocity().y);
+    b.angularVelocity = body->GetAngularVelocity();
+    bodies.push_back(b);
+}
+
+inline void SceneWriter::addPolyline(const std::vector<vec2> &vertices) {
+    polylineSizes.push_back(vertices.size());
+    this->vertices.insert(this->vertices.end(), vertices.begin(), vertices.end());
+}
+
+// Returns false if the file couldn't be written completely.
+inline bool SceneWriter::write(const std::string &path) const {
+    SceneHeader h;
+    memcpy(h.magic, "PPSC", 4);
+    h.version = 1;
+    h.bodyCount = bodies.size();
+    h.polylineCount = polylineSizes.size();
+    h.vertexCount = vertices.size();
+    std::vector<char> data(sizeof(h) + bodies.size()*sizeof(SceneBody) +
+                           polylineSizes.size()*sizeof(int) + vertices.size()*sizeof(vec2));
+    char *p = &data[0];
+    memcpy(p, &h, sizeof(h));
+    p += sizeof(h);
+    if (!bodies.empty())
+        memcpy(p, &bodies[0], bodies.size()*sizeof(SceneBody));
+    p += bodies.size()*sizeof(SceneBody);
+    if (!polylineSizes.empty())
+        memcpy(p, &polylineSizes[0], polylineSizes.size()*sizeof(int));
+    p += polylineSizes.size()*sizeof(int);
+    if (!vertices.empty())
+        memcpy(p, &vertices[0], vertices.size()*sizeof(vec2));
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == NULL)
+        return false;
+    bool ok = fwrite(&data[0], 1, data.size(), file) == data.size();
+    return (fclose(file) == 0) && ok;
+}
+
+// Returns false if the file is missing, from another version, or doesn't
+// hold exactly what its header says.
+inline bool SceneReader::open(const std::string &path) {
+    close();
+    SceneHeader h;
+    if (!file.open(path) || file.size < sizeof(h))
+        return false;
+    memcpy(&h, file.data, sizeof(h));
+    if (memcmp(h.magic, "PPSC", 4) != 0 || h.version != 1 ||
+        h.bodyCount < 0 || h.polylineCount < 0 || h.vertexCount < 0 ||
+        file.size != sizeof(h) + (size_t)h.bodyCount*sizeof(SceneBody) +
+                     (size_t)h.polylineCount*sizeof(int) + (size_t)h.vertexCount*sizeof(vec2)) {
+        close();
+        return false;
+    }
+    const char *p = file.data + sizeof(h);
+    bodies = (const SceneBody*)p;
+    p += h.bodyCount*sizeof(SceneBody);
+    polylineSizes = (const int*)p;
+    p += h.polylineCount*sizeof(int);
+    vertices = (const vec2*)p;
+    long long total = 0;
+    for (int i = 0; i < h.polylineCount; i++) {
+        if (polylineSizes[i] < 0) {
+            total = -1;
+            break;
+        }
+        total += polylineSizes[i];
+    }
+    if (total != h.vertexCount) {
+        close();
+        return false;
+    }
+    bodyCount = h.bodyCount;
+    polylineCount = h.polylineCount;
+    return true;
+}
+
+inline void SceneReader::close() {
+    file.close();
+    bodyCount = polylineCount = 0;
+    bodies = NULL;
+    polylineSizes = NULL;
+    vertices = NULL;
+}
+
+// Definition of a dynamic body in the saved state of body index.
+inline b2BodyDef SceneReader::bodyDef(int index) const {
+    const SceneBody &b = bodies[index];
+    b2BodyDef def;
+    def.type = b2_dynamicBody;
+    def.position.Set(b.position.x, b.position.y);
+    def.angle = b.angle;
+    def.linearVelocity.Set(b.linearVelocity.x, b.linearVelocity.y);
+    def.angularVelocity = b.angularVelocity;
+    def.awake = (b.awake != 0);
+    return def;
+}
+
+#endif
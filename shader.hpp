@@ -2,7 +2,12 @@
 #define SHADER_HPP
 
 #include "engine.hpp"
+#include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <map>
+#include <string>
+#include <vector>
 #include <glm/glm.hpp>
 
 using glm::vec2;
@@ -10,11 +15,41 @@ using glm::vec3;
 using glm::vec4;
 using glm::mat4;
 
+// Handle to an active uniform of type T, from ShaderProgram::uniform. A
+// uniform the linker dropped gets a handle that ignores every set.
+template <typename T>
+struct ShaderUniform {
+    int index;
+    ShaderUniform(): index(-1) {}
+    explicit ShaderUniform(int index): index(index) {}
+};
+
+// Handle to an active vertex attribute, from ShaderProgram::attribute.
+struct ShaderAttribute {
+    GLint location;
+    ShaderAttribute(): location(-1) {}
+    explicit ShaderAttribute(GLint location): location(location) {}
+};
+
+// Looks up every active uniform and attribute once after linking, so
+// setting one by handle costs no driver query. Uniform values are cached
+// and only sent when they change. The string overloads look the name up
+// in the tables on each call.
 class ShaderProgram {
 public:
     ShaderProgram(): vertexShader(0), fragmentShader(0), program(0), vao(0) {}
     ShaderProgram(std::string vertFile, std::string fragFile);
+    template <typename T> ShaderUniform<T> uniform(const std::string &name) const;
+    ShaderAttribute attribute(const std::string &name) const;
+    void setUniformBlock(const std::string &name, int binding);
+    void setAttribute(ShaderAttribute attrib, VertexBuffer buffer, int dim, GLenum type,
+                      int stride=0, int offset=0);
+    void setInstanceAttribute(ShaderAttribute attrib, VertexBuffer buffer, int dim, GLenum type,
+                              int stride, int offset);
+    template <typename T> void setUniform(ShaderUniform<T> uniform, const T &value);
     void setAttribute(std::string name, VertexBuffer buffer, int dim, GLenum type);
+    void setInstanceAttribute(std::string name, VertexBuffer buffer, int dim, GLenum type,
+                              int stride, int offset);
     void setUniform(std::string name, int i);
     void setUniform(std::string name, float f);
     void setUniform(std::string name, vec2 v);
@@ -25,12 +60,43 @@ public:
     void enable();
     void disable();
 protected:
+    struct UniformInfo {
+        GLint location;
+        GLenum type;
+        bool sent;
+        float value[16]; // big enough for a mat4
+    };
     GLuint vertexShader, fragmentShader;
     GLuint program;
     GLuint vao;
+    std::vector<UniformInfo> uniforms;
+    std::map<std::string, int> uniformIndices;
+    std::map<std::string, GLint> attributeLocations;
     GLuint loadShader(GLenum type, std::string filename);
+    void reflect();
 };
 
+// Definitions below
+
+// GL type of a uniform that takes a T, and how to send one.
+inline bool uniformTypeMatches(GLenum type, int) {
+    return type == GL_INT || type == GL_BOOL || type == GL_SAMPLER_2D;
+}
+inline bool uniformTypeMatches(GLenum type, float) { return type == GL_FLOAT; }
+inline bool uniformTypeMatches(GLenum type, vec2) { return type == GL_FLOAT_VEC2; }
+inline bool uniformTypeMatches(GLenum type, vec3) { return type == GL_FLOAT_VEC3; }
+inline bool uniformTypeMatches(GLenum type, vec4) { return type == GL_FLOAT_VEC4; }
+inline bool uniformTypeMatches(GLenum type, mat4) { return type == GL_FLOAT_MAT4; }
+
+inline void sendUniform(GLint location, int i) { glUniform1i(location, i); }
+inline void sendUniform(GLint location, float f) { glUniform1f(location, f); }
+inline void sendUniform(GLint location, vec2 v) { glUniform2f(location, v[0], v[1]); }
+inline void sendUniform(GLint location, vec3 v) { glUniform3f(location, v[0], v[1], v[2]); }
+inline void sendUniform(GLint location, vec4 v) { glUniform4f(location, v[0], v[1], v[2], v[3]); }
+inline void sendUniform(GLint location, const mat4 &m) {
+    glUniformMatrix4fv(location, 1, GL_FALSE, &m[0][0]);
+}
+
 inline ShaderProgram::ShaderProgram(std::string vertFile, std::string fragFile) {
     vertexShader = loadShader(GL_VERTEX_SHADER, vertFile);
     fragmentShader = loadShader(GL_FRAGMENT_SHADER, fragFile);
@@ -47,6 +113,7 @@ inline ShaderProgram::ShaderProgram(std::string vertFile, std::string fragFile)
         exit(EXIT_FAILURE);
     }
     glGenVertexArrays(1, &vao);
+    reflect();
     Engine::dieIfOpenGLError();
 }
 
@@ -75,59 +142,141 @@ inline GLuint ShaderProgram::loadShader(GLenum type, std::string filename) {
     return shader;
 }
 
-inline void ShaderProgram::setAttribute(std::string name, VertexBuffer buffer, int dim, GLenum type) {
+// Uniforms in a block have no location of their own and are left out;
+// the block is bound with setUniformBlock.
+inline void ShaderProgram::reflect() {
+    char name[256];
+    GLint count = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    for (int i = 0; i < count; i++) {
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(program, i, sizeof(name), NULL, &size, &type, name);
+        GLint location = glGetUniformLocation(program, name);
+        if (location == -1)
+            continue;
+        std::string key(name);
+        if (key.size() > 3 && key.compare(key.size()-3, 3, "[0]") == 0)
+            key.resize(key.size()-3);
+        UniformInfo info;
+        info.location = location;
+        info.type = type;
+        info.sent = false;
+        uniformIndices[key] = uniforms.size();
+        uniforms.push_back(info);
+    }
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+    for (int i = 0; i < count; i++) {
+        GLint size;
+        GLenum type;
+        glGetActiveAttrib(program, i, sizeof(name), NULL, &size, &type, name);
+        attributeLocations[name] = glGetAttribLocation(program, name);
+    }
+}
+
+template <typename T>
+inline ShaderUniform<T> ShaderProgram::uniform(const std::string &name) const {
+    std::map<std::string, int>::const_iterator it = uniformIndices.find(name);
+    if (it == uniformIndices.end())
+        return ShaderUniform<T>();
+    if (!uniformTypeMatches(uniforms[it->second].type, T())) {
+        Engine::errorMessage("Uniform " + name + " has a different type in the shader");
+        exit(EXIT_FAILURE);
+    }
+    return ShaderUniform<T>(it->second);
+}
+
+inline ShaderAttribute ShaderProgram::attribute(const std::string &name) const {
+    std::map<std::string, GLint>::const_iterator it = attributeLocations.find(name);
+    return (it == attributeLocations.end()) ? ShaderAttribute() : ShaderAttribute(it->second);
+}
+
+// Has the uniform block read from the uniform buffer bound at binding.
+inline void ShaderProgram::setUniformBlock(const std::string &name, int binding) {
+    GLuint block = glGetUniformBlockIndex(program, name.c_str());
+    if (block != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, block, binding);
+    Engine::dieIfOpenGLError();
+}
+
+// stride and offset are in bytes, for interleaved buffers.
+inline void ShaderProgram::setAttribute(ShaderAttribute attrib, VertexBuffer buffer, int dim, GLenum type,
+                                        int stride, int offset) {
     glBindVertexArray(vao);
     glBindBuffer(GL_ARRAY_BUFFER, buffer);
-    GLint attrib = glGetAttribLocation(program, name.c_str());
-    if (attrib != -1) {
-        glVertexAttribPointer(attrib, dim, type, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(attrib);
+    if (attrib.location != -1) {
+        glVertexAttribPointer(attrib.location, dim, type, GL_FALSE, stride, (void*)(intptr_t)offset);
+        glEnableVertexAttribArray(attrib.location);
     }
     Engine::dieIfOpenGLError();
 }
 
-inline void ShaderProgram::setUniform(std::string name, int i) {
-    GLint uniform = glGetUniformLocation(program, name.c_str());
-    glUniform1i(uniform, i);
+// Like setAttribute, but the attribute advances once per instance and is
+// read from an interleaved buffer with the given stride and byte offset.
+inline void ShaderProgram::setInstanceAttribute(ShaderAttribute attrib, VertexBuffer buffer, int dim,
+                                                GLenum type, int stride, int offset) {
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (attrib.location != -1) {
+        glVertexAttribPointer(attrib.location, dim, type, GL_FALSE, stride, (void*)(intptr_t)offset);
+        glVertexAttribDivisor(attrib.location, 1);
+        glEnableVertexAttribArray(attrib.location);
+    }
     Engine::dieIfOpenGLError();
 }
 
-inline void ShaderProgram::setUniform(std::string name, float f) {
-    GLint uniform = glGetUniformLocation(program, name.c_str());
-    glUniform1f(uniform, f);
+// The program must be enabled. Skips the GL call if the uniform already
+// holds value.
+template <typename T>
+inline void ShaderProgram::setUniform(ShaderUniform<T> uniform, const T &value) {
+    if (uniform.index < 0)
+        return;
+    UniformInfo &info = uniforms[uniform.index];
+    if (info.sent && memcmp(info.value, &value, sizeof(T)) == 0)
+        return;
+    memcpy(info.value, &value, sizeof(T));
+    info.sent = true;
+    sendUniform(info.location, value);
     Engine::dieIfOpenGLError();
 }
 
+inline void ShaderProgram::setAttribute(std::string name, VertexBuffer buffer, int dim, GLenum type) {
+    setAttribute(attribute(name), buffer, dim, type);
+}
+
+inline void ShaderProgram::setInstanceAttribute(std::string name, VertexBuffer buffer, int dim,
+                                                GLenum type, int stride, int offset) {
+    setInstanceAttribute(attribute(name), buffer, dim, type, stride, offset);
+}
+
+inline void ShaderProgram::setUniform(std::string name, int i) {
+    setUniform(uniform<int>(name), i);
+}
+
+inline void ShaderProgram::setUniform(std::string name, float f) {
+    setUniform(uniform<float>(name), f);
+}
+
 inline void ShaderProgram::setUniform(std::string name, vec2 v) {
-    GLint uniform = glGetUniformLocation(program, name.c_str());
-    glUniform2f(uniform, v[0], v[1]);
-    Engine::dieIfOpenGLError();
+    setUniform(uniform<vec2>(name), v);
 }
 
 inline void ShaderProgram::setUniform(std::string name, vec3 v) {
-    GLint uniform = glGetUniformLocation(program, name.c_str());
-    glUniform3f(uniform, v[0], v[1], v[2]);
-    Engine::dieIfOpenGLError();
+    setUniform(uniform<vec3>(name), v);
 }
 
 inline void ShaderProgram::setUniform(std::string name, vec4 v) {
-    GLint uniform = glGetUniformLocation(program, name.c_str());
-    glUniform4f(uniform, v[0], v[1], v[2], v[3]);
-    Engine::dieIfOpenGLError();
+    setUniform(uniform<vec4>(name), v);
 }
 
 inline void ShaderProgram::setUniform(std::string name, mat4 m) {
-    GLint uniform = glGetUniformLocation(program, name.c_str());
-    glUniformMatrix4fv(uniform, 1, GL_FALSE, &m[0][0]);
-    Engine::dieIfOpenGLError();
+    setUniform(uniform<mat4>(name), m);
 }
 
 inline void ShaderProgram::setTexture(std::string name, Texture tex, int texUnit) {
     glActiveTexture(GL_TEXTURE0 + texUnit);
     glBindTexture(GL_TEXTURE_2D, tex);
-    GLint uniform = glGetUniformLocation(program, name.c_str());
-    glUniform1i(uniform, texUnit);
-    Engine::dieIfOpenGLError();
+    setUniform(uniform<int>(name), texUnit);
 }
 
 inline void ShaderProgram::enable() {
@@ -8,110 +8,58 @@ using namespace std;
 using glm::vec2;
 
 
-class Circle {
-public:
-    vec2 center;
-    float radius;
-	b2Body* circle_body;
-	mat4 rotation;
-
-	vec2 getLocalPoint(vec2 worldPoint)
-	{
-		return vec2(circle_body->GetPosition().x, circle_body->GetPosition().x);
-	}
-
-	mat4 getTransformation()
-	{
-		return glm::translate(mat4(),vec3(circle_body->GetPosition().x, circle_body->GetPosition().y, 0)) * glm::rotate(mat4(),circle_body->GetAngle(), vec3(0, 0, 1));
-	}
-
-    Circle(vec2 center, float radius, b2World *world_ptr) {
-		this->center = center;
-		this->radius = radius;
-
-		b2BodyDef circle_def;
-		circle_def.type = b2_dynamicBody;
-		circle_def.position.Set(center.x, center.y);
-		circle_def.linearVelocity.Set(0, 0);
-		circle_def.angularVelocity = 0.1;
-		b2Body *circle_body = world_ptr->CreateBody(&circle_def);
-
-		b2CircleShape b2_circle;
-		b2_circle.m_p.Set(0, 0);
-		b2_circle.m_radius = radius;
-
-		b2FixtureDef fixtureDef;
-		fixtureDef.shape = &b2_circle;
-		fixtureDef.density = .2;
-		fixtureDef.friction = .4;
-		fixtureDef.restitution = .4;
-		circle_body->CreateFixture(&fixtureDef);
-
-		this->circle_body = circle_body;
-	}
-
-
-    Circle(vec2 center, float radius) {
-        this->center = center;
-        this->radius = radius;
-    }
-
-	Circle() {}
-
-    bool contains(vec2 worldPoint) {
-        return glm::length(worldPoint - center) <= radius;
-    }
-    void destroy() {}
-
-
-};
-
-class Box {
-public:
-    vec2 center;
-    vec2 size;
-	b2Body* rect_body;
-
-	mat4 getTransformation()
-	{
-		return glm::translate(mat4(), vec3(rect_body->GetPosition().x, rect_body->GetPosition().y, 0)) * glm::rotate(mat4(), rect_body->GetAngle(), vec3(0, 0, 1));
-	}
-
-    Box() {}
-    Box(vec2 center, vec2 size) {
-        this->center = center;
-        this->size = size;
-    }
-
-	Box(vec2 center, vec2 size, b2World *world_ptr) {
-		this->center = center;
-		this->size = size;
-
-		b2BodyDef rect_def;
-		rect_def.type = b2_dynamicBody;
-		rect_def.position.Set(center.x, center.y);
-		rect_def.linearVelocity.Set(0, 0);
-		rect_def.angularVelocity = 0.1;
-		b2Body *rect_body = world_ptr->CreateBody(&rect_def);
-
-		b2PolygonShape polygon;
-		polygon.SetAsBox(size.x/2, size.y/2);
-		b2FixtureDef fixtureDef_box;
-		fixtureDef_box.shape = &polygon;
-		fixtureDef_box.density = .2;
-		fixtureDef_box.friction = .4;
-		fixtureDef_box.restitution = .4;
-		rect_body->CreateFixture(&fixtureDef_box);
-
-		this->rect_body = rect_body;
-	}
-
-    bool contains(vec2 worldPoint) {
-        vec2 d = worldPoint - center;
-        return (abs(d.x) <= size.x/2 && abs(d.y) <= size.y/2);
-    }
-    void destroy() {}
-};
+// Circles and boxes live in a BodyRegistry (registry.hpp); these create
+// their Box2D bodies.
+
+// The versions taking a b2BodyDef let a saved scene restore each body's
+// transform, velocities and awake flag as it is created.
+inline b2Body* createCircleBody(b2World *world_ptr, const b2BodyDef &circle_def, float radius) {
+	b2Body *circle_body = world_ptr->CreateBody(&circle_def);
+
+	b2CircleShape b2_circle;
+	b2_circle.m_p.Set(0, 0);
+	b2_circle.m_radius = radius;
+
+	b2FixtureDef fixtureDef;
+	fixtureDef.shape = &b2_circle;
+	fixtureDef.density = .2;
+	fixtureDef.friction = .4;
+	fixtureDef.restitution = .4;
+	circle_body->CreateFixture(&fixtureDef);
+	return circle_body;
+}
+
+inline b2Body* createCircleBody(b2World *world_ptr, vec2 center, float radius, b2BodyType type=b2_dynamicBody) {
+	b2BodyDef circle_def;
+	circle_def.type = type;
+	circle_def.position.Set(center.x, center.y);
+	circle_def.linearVelocity.Set(0, 0);
+	circle_def.angularVelocity = 0.1;
+	return createCircleBody(world_ptr, circle_def, radius);
+}
+
+inline b2Body* createBoxBody(b2World *world_ptr, const b2BodyDef &rect_def, vec2 size) {
+	b2Body *rect_body = world_ptr->CreateBody(&rect_def);
+
+	b2PolygonShape polygon;
+	polygon.SetAsBox(size.x/2, size.y/2);
+	b2FixtureDef fixtureDef_box;
+	fixtureDef_box.shape = &polygon;
+	fixtureDef_box.density = .2;
+	fixtureDef_box.friction = .4;
+	fixtureDef_box.restitution = .4;
+	rect_body->CreateFixture(&fixtureDef_box);
+	return rect_body;
+}
+
+inline b2Body* createBoxBody(b2World *world_ptr, vec2 center, vec2 size, b2BodyType type=b2_dynamicBody) {
+	b2BodyDef rect_def;
+	rect_def.type = type;
+	rect_def.position.Set(center.x, center.y);
+	rect_def.linearVelocity.Set(0, 0);
+	rect_def.angularVelocity = 0.1;
+	return createBoxBody(world_ptr, rect_def, size);
+}
 
 class Polyline {
 public:
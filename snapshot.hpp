@@ -0,0 +1,82 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include "debugdraw.hpp"
+#include "graphics.hpp"
+#include "registry.hpp"
+#include <atomic>
+#include <vector>
+#include <glm/glm.hpp>
+using glm::vec2;
+
+// Everything the render thread needs from the physics thread to draw one
+// frame. bodies is a copy of the registry entries near the camera's view;
+// culledBodies counts the ones left out.
+struct Snapshot {
+    BodyArrays bodies;
+    int culledBodies;
+    // Polylines only change on user input, so a slot copies them only when
+    // its version is behind the physics thread's.
+    std::vector<std::vector<vec2> > polylines;
+    int polylineVersion;
+    // What b2World::DrawDebugData drew, if any debug draw flags are on.
+    DebugGeometry debug;
+    // Performance counter when the snapshot was published, the step length,
+    // and the sub-steps and leftover accumulator time of that update.
+    Uint64 time;
+    float dt;
+    int subSteps;
+    float leftover;
+    Snapshot(): culledBodies(0), polylineVersion(-1), time(0), dt(0), subSteps(0), leftover(0) {}
+};
+
+// Lock-free single producer, single consumer triple buffer. The writer
+// fills writeBuffer() and publishes it; the reader picks up the latest
+// published slot with update() and keeps reading it until the next
+// update(). Neither side ever waits, and the slot being written is never
+// the one being read.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer(): back(0), middle(1), front(2) {}
+    T& writeBuffer();
+    void publish();
+    bool update();
+    const T& readBuffer() const;
+protected:
+    enum {IndexMask = 3, FreshBit = 4};
+    T slots[3];
+    int back;
+    std::atomic<int> middle;
+    int front;
+};
+
+// Definitions below
+
+template <typename T>
+inline T& TripleBuffer<T>::writeBuffer() {
+    return slots[back];
+}
+
+// Swaps the written slot into the middle and takes the old middle slot
+// to write next.
+template <typename T>
+inline void TripleBuffer<T>::publish() {
+    back = middle.exchange(back | FreshBit, std::memory_order_acq_rel) & IndexMask;
+}
+
+// Returns true if a newer slot was published since the last call.
+template <typename T>
+inline bool TripleBuffer<T>::update() {
+    if (!(middle.load(std::memory_order_relaxed) & FreshBit))
+        return false;
+    front = middle.exchange(front, std::memory_order_acq_rel) & IndexMask;
+    return true;
+}
+
+template <typename T>
+inline const T& TripleBuffer<T>::readBuffer() const {
+    return slots[front];
+}
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef STROKE_HPP
+#define STROKE_HPP
+
+#include <cmath>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+#include <Box2D/Box2D.h>
+using glm::vec2;
+
+// Cleans up a hand-drawn stroke before it becomes a b2ChainShape, where
+// every vertex is an edge with its own broad-phase proxy. First
+// Douglas-Peucker drops every vertex the stroke can do without while
+// staying within tolerance of what was drawn. Then a resampling pass
+// merges the short edges left on gentle curves, but keeps the vertices
+// where the stroke turns sharply, so corners stay crisp.
+class StrokeFilter {
+public:
+    float tolerance;   // max distance from the drawn stroke, world units
+    float minEdge;     // edges shorter than this are merged if not a corner
+    float cornerAngle; // turns sharper than this (radians) are corners
+    int inputCount, outputCount;
+    StrokeFilter(float tolerance=0.02, float minEdge=0.25, float cornerAngle=0.5):
+        tolerance(tolerance), minEdge(minEdge), cornerAngle(cornerAngle),
+        inputCount(0), outputCount(0) {}
+    std::vector<vec2> apply(const std::vector<vec2> &stroke);
+    std::vector<vec2> simplify(const std::vector<vec2> &stroke) const;
+    std::vector<vec2> resample(const std::vector<vec2> &stroke) const;
+};
+
+// Definitions below
+
+// Distance from p to the segment ab.
+inline float distanceToSegment(vec2 p, vec2 a, vec2 b) {
+    vec2 ab = b - a;
+    float len2 = glm::dot(ab, ab);
+    float t = (len2 > 0) ? glm::clamp(glm::dot(p - a, ab)/len2, 0.0f, 1.0f) : 0;
+    return glm::length(p - (a + t*ab));
+}
+
+// Runs both passes and records the vertex counts before and after.
+inline std::vector<vec2> StrokeFilter::apply(const std::vector<vec2> &stroke) {
+    std::vector<vec2> result = resample(simplify(stroke));
+    inputCount = stroke.size();
+    outputCount = result.size();
+    return result;
+}
+
+// Douglas-Peucker with an explicit stack, so a long stroke can't overflow
+// the call stack.
+inline std::vector<vec2> StrokeFilter::simplify(const std::vector<vec2> &stroke) const {
+    int n = stroke.size();
+    if (n < 3)
+        return stroke;
+    std::vector<char> keep(n, 0);
+    keep[0] = keep[n-1] = 1;
+    std::vector<std::pair<int,int> > ranges;
+    ranges.push_back(std::make_pair(0, n-1));
+    while (!ranges.empty()) {
+        int first = ranges.back().first, last = ranges.back().second;
+        ranges.pop_back();
+        float farthest = 0;
+        int index = -1;
+        for (int i = first+1; i < last; i++) {
+            float d = distanceToSegment(stroke[i], stroke[first], stroke[last]);
+            if (d > farthest) {
+                farthest = d;
+                index = i;
+            }
+        }
+        if (index < 0 || farthest <= tolerance)
+            continue;
+        keep[index] = 1;
+        ranges.push_back(std::make_pair(first, index));
+        ranges.push_back(std::make_pair(index, last));
+    }
+    std::vector<vec2> result;
+    for (int i = 0; i < n; i++)
+        if (keep[i])
+            result.push_back(stroke[i]);
+    return result;
+}
+
+// Drops a vertex if the edge into it is short, the stroke doesn't turn
+// sharply there, and skipping it keeps the stroke within tolerance. Also
+// drops vertices too close together for b2ChainShape to accept.
+inline std::vector<vec2> StrokeFilter::resample(const std::vector<vec2> &stroke) const {
+    int n = stroke.size();
+    if (n < 3)
+        return stroke;
+    const float minDistance = 2*b2_linearSlop;
+    float cosCorner = std::cos(cornerAngle);
+    std::vector<vec2> result;
+    result.push_back(stroke[0]);
+    for (int i = 1; i < n-1; i++) {
+        vec2 prev = result.back(), p = stroke[i], next = stroke[i+1];
+        vec2 in = p - prev, out = next - p;
+        float inLength = glm::length(in), outLength = glm::length(out);
+        if (inLength < minDistance)
+            continue;
+        if (inLength < minEdge && outLength > 0 &&
+            glm::dot(in, out) >= cosCorner*inLength*outLength &&
+            distanceToSegment(p, prev, next) <= tolerance)
+            continue;
+        result.push_back(p);
+    }
+    if (result.size() > 1 && glm::length(stroke[n-1] - result.back()) < minDistance)
+        result.pop_back();
+    result.push_back(stroke[n-1]);
+    return result;
+}
+
+#endif
@@ -1,7 +1,12 @@
 #ifndef UIHELPER_HPP
 #define UIHELPER_HPP
 
+#include "camera.hpp"
 #include "engine.hpp"
+#include "stroke.hpp"
+#include <cmath>
+#include <cstdio>
+#include <mutex>
 #include <vector>
 #include <glm/glm.hpp>
 using glm::vec2;
@@ -15,33 +20,218 @@ public:
     virtual void attachMouse(vec2 point) = 0;
     virtual void moveMouse(vec2 point) = 0;
     virtual void detachMouse() = 0;
+    virtual void toggleProfiling() = 0;
+    virtual void setView(vec2 viewMin, vec2 viewMax) = 0;
+    virtual void setDebugDrawFlags(int flags) = 0;
+    virtual void saveScene() = 0;
+    virtual void loadScene() = 0;
 };
 
+// Records UIMain calls made on one thread so another thread can replay
+// them with apply(), e.g. the UI thread queueing actions for the physics
+// thread to run between steps.
+class UICommandQueue: public UIMain {
+public:
+    void addCircle();
+    void addBox();
+    void addPolyline(std::vector<vec2> vertices);
+    void clear();
+    void attachMouse(vec2 point);
+    void moveMouse(vec2 point);
+    void detachMouse();
+    void toggleProfiling();
+    void setView(vec2 viewMin, vec2 viewMax);
+    void setDebugDrawFlags(int flags);
+    void saveScene();
+    void loadScene();
+    void apply(UIMain *target);
+protected:
+    struct Command {
+        enum {AddCircle, AddBox, AddPolyline, Clear,
+              AttachMouse, MoveMouse, DetachMouse, ToggleProfiling,
+              SetView, SetDebugDrawFlags, SaveScene, LoadScene} type;
+        vec2 point, point2;
+        int flags;
+        std::vector<vec2> vertices;
+    };
+    std::mutex mutex;
+    std::vector<Command> pending, applying;
+    void push(const Command &command);
+};
+
+// Left button draws or pulls, depending on the mode; the right button
+// pans the camera and the wheel zooms it about the cursor.
 class UIHelper {
 public:
     UIMain *main;
-    vec2 worldMin, worldMax;
+    Camera2D *camera;
     int width, height;
     enum {DrawMode, PullMode} dragMode;
-    bool mouseDown;
+    bool mouseDown, panning;
+    int panX, panY;
+    // b2Draw flags, toggled with 1 to 5: shapes, joints, AABBs, pairs,
+    // centers of mass.
+    int debugDrawFlags;
     std::vector<vec2> polyline;
     float edgeMin;
-    UIHelper(): main(NULL) {}
-    UIHelper(UIMain *main, vec2 worldMin, vec2 worldMax, int width, int height);
+    // Applied to each finished stroke before it is handed to addPolyline.
+    // With strokeStats set, prints the vertex counts before and after.
+    StrokeFilter strokeFilter;
+    bool strokeStats;
+    UIHelper(): main(NULL), camera(NULL), debugDrawFlags(0), strokeStats(false) {}
+    UIHelper(UIMain *main, Camera2D *camera, int width, int height);
     std::vector<vec2> getPolyline();
     void onKeyDown(SDL_KeyboardEvent &e);
     void onKeyUp(SDL_KeyboardEvent &e);
     void onMouseButtonDown(SDL_MouseButtonEvent &e);
     void onMouseButtonUp(SDL_MouseButtonEvent &e);
     void onMouseMotion(SDL_MouseMotionEvent &e);
+    void onMouseWheel(SDL_MouseWheelEvent &e);
     vec2 windowToWorld(int x, int y);
 };
 
-inline UIHelper::UIHelper(UIMain *main, vec2 worldMin, vec2 worldMax, int w, int h):
-    main(main), worldMin(worldMin), worldMax(worldMax), width(w), height(h) {
+inline void UICommandQueue::push(const Command &command) {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.push_back(command);
+}
+
+inline void UICommandQueue::addCircle() {
+    Command command;
+    command.type = Command::AddCircle;
+    push(command);
+}
+
+inline void UICommandQueue::addBox() {
+    Command command;
+    command.type = Command::AddBox;
+    push(command);
+}
+
+inline void UICommandQueue::addPolyline(std::vector<vec2> vertices) {
+    Command command;
+    command.type = Command::AddPolyline;
+    command.vertices.swap(vertices);
+    push(command);
+}
+
+inline void UICommandQueue::clear() {
+    Command command;
+    command.type = Command::Clear;
+    push(command);
+}
+
+inline void UICommandQueue::attachMouse(vec2 point) {
+    Command command;
+    command.type = Command::AttachMouse;
+    command.point = point;
+    push(command);
+}
+
+inline void UICommandQueue::moveMouse(vec2 point) {
+    Command command;
+    command.type = Command::MoveMouse;
+    command.point = point;
+    push(command);
+}
+
+inline void UICommandQueue::detachMouse() {
+    Command command;
+    command.type = Command::DetachMouse;
+    push(command);
+}
+
+inline void UICommandQueue::toggleProfiling() {
+    Command command;
+    command.type = Command::ToggleProfiling;
+    push(command);
+}
+
+inline void UICommandQueue::setDebugDrawFlags(int flags) {
+    Command command;
+    command.type = Command::SetDebugDrawFlags;
+    command.flags = flags;
+    push(command);
+}
+
+inline void UICommandQueue::saveScene() {
+    Command command;
+    command.type = Command::SaveScene;
+    push(command);
+}
+
+inline void UICommandQueue::loadScene() {
+    Command command;
+    command.type = Command::LoadScene;
+    push(command);
+}
+
+inline void UICommandQueue::setView(vec2 viewMin, vec2 viewMax) {
+    Command command;
+    command.type = Command::SetView;
+    command.point = viewMin;
+    command.point2 = viewMax;
+    push(command);
+}
+
+// Runs the queued calls on target in the order they were made. The lock
+// is only held to take the queue, not while the calls run.
+inline void UICommandQueue::apply(UIMain *target) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.swap(applying);
+    }
+    for (int i = 0; i < applying.size(); i++) {
+        Command &command = applying[i];
+        switch (command.type) {
+        case Command::AddCircle:
+            target->addCircle();
+            break;
+        case Command::AddBox:
+            target->addBox();
+            break;
+        case Command::AddPolyline:
+            target->addPolyline(command.vertices);
+            break;
+        case Command::Clear:
+            target->clear();
+            break;
+        case Command::AttachMouse:
+            target->attachMouse(command.point);
+            break;
+        case Command::MoveMouse:
+            target->moveMouse(command.point);
+            break;
+        case Command::DetachMouse:
+            target->detachMouse();
+            break;
+        case Command::ToggleProfiling:
+            target->toggleProfiling();
+            break;
+        case Command::SetView:
+            target->setView(command.point, command.point2);
+            break;
+        case Command::SetDebugDrawFlags:
+            target->setDebugDrawFlags(command.flags);
+            break;
+        case Command::SaveScene:
+            target->saveScene();
+            break;
+        case Command::LoadScene:
+            target->loadScene();
+            break;
+        }
+    }
+    applying.clear();
+}
+
+inline UIHelper::UIHelper(UIMain *main, Camera2D *camera, int w, int h):
+    main(main), camera(camera), width(w), height(h) {
     dragMode = DrawMode;
     mouseDown = false;
+    panning = false;
+    debugDrawFlags = 0;
     edgeMin = 0.1;
+    strokeStats = false;
 }
 
 inline std::vector<vec2> UIHelper::getPolyline() {
@@ -55,6 +245,15 @@ inline void UIHelper::onKeyDown(SDL_KeyboardEvent &e) {
         main->addCircle();
     } else if (e.keysym.scancode == SDL_SCANCODE_BACKSPACE) {
         main->clear();
+    } else if (e.keysym.scancode == SDL_SCANCODE_P) {
+        main->toggleProfiling();
+    } else if (e.keysym.scancode == SDL_SCANCODE_S) {
+        main->saveScene();
+    } else if (e.keysym.scancode == SDL_SCANCODE_L) {
+        main->loadScene();
+    } else if (e.keysym.scancode >= SDL_SCANCODE_1 && e.keysym.scancode <= SDL_SCANCODE_5) {
+        debugDrawFlags ^= 1 << (e.keysym.scancode - SDL_SCANCODE_1);
+        main->setDebugDrawFlags(debugDrawFlags);
     } else if (e.keysym.scancode == SDL_SCANCODE_TAB) {
         if (!mouseDown)
             dragMode = (dragMode==DrawMode) ? PullMode : DrawMode;
@@ -65,6 +264,14 @@ inline void UIHelper::onKeyUp(SDL_KeyboardEvent &e) {
 }
 
 inline void UIHelper::onMouseButtonDown(SDL_MouseButtonEvent &e) {
+    if (e.button == SDL_BUTTON_RIGHT) {
+        panning = true;
+        panX = e.x;
+        panY = e.y;
+        return;
+    }
+    if (mouseDown)
+        return;
     mouseDown = true;
     vec2 point = windowToWorld(e.x,e.y);
     if (dragMode == DrawMode) {
@@ -75,10 +282,21 @@ inline void UIHelper::onMouseButtonDown(SDL_MouseButtonEvent &e) {
 }
 
 inline void UIHelper::onMouseButtonUp(SDL_MouseButtonEvent &e) {
+    if (e.button == SDL_BUTTON_RIGHT) {
+        panning = false;
+        return;
+    }
+    if (!mouseDown)
+        return;
     mouseDown = false;
     if (dragMode == DrawMode) {
-        if (polyline.size() > 1)
-            main->addPolyline(polyline);
+        if (polyline.size() > 1) {
+            std::vector<vec2> stroke = strokeFilter.apply(polyline);
+            if (strokeStats)
+                printf("stroke: %d -> %d vertices\n",
+                       strokeFilter.inputCount, strokeFilter.outputCount);
+            main->addPolyline(stroke);
+        }
         polyline.clear();
     } else {
         main->detachMouse();
@@ -86,6 +304,12 @@ inline void UIHelper::onMouseButtonUp(SDL_MouseButtonEvent &e) {
 }
 
 inline void UIHelper::onMouseMotion(SDL_MouseMotionEvent &e) {
+    if (panning) {
+        camera->pan(windowToWorld(panX,panY) - windowToWorld(e.x,e.y));
+        panX = e.x;
+        panY = e.y;
+        main->setView(camera->viewMin(), camera->viewMax());
+    }
     if (!mouseDown)
         return;
     vec2 point = windowToWorld(e.x,e.y);
@@ -97,9 +321,16 @@ inline void UIHelper::onMouseMotion(SDL_MouseMotionEvent &e) {
     }
 }
 
+inline void UIHelper::onMouseWheel(SDL_MouseWheelEvent &e) {
+    int x, y;
+    SDL_GetMouseState(&x, &y);
+    camera->zoomAt(windowToWorld(x,y), std::pow(1.1f, (float)e.y));
+    main->setView(camera->viewMin(), camera->viewMax());
+}
+
 inline vec2 UIHelper::windowToWorld(int x, int y) {
     vec2 u = vec2((float)x/width, (float)(height-1-y)/height);
-    return worldMin + u*(worldMax - worldMin);
+    return camera->viewToWorld(u);
 }
 
 #endif